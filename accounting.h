@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+// Build with -DSMART_POINTERS_ACCOUNTING to keep per-type statistics of live control blocks:
+// how many there are, how many bytes their objects take, and the type's share of
+// `WeakPinnedBytes()` (bytes of in-place blocks that only weak references keep after the objects
+// are gone). `SnapshotBlockStats()` reads all of them, e.g. for a metrics exporter. Counters are
+// sharded by thread so that accounting adds no contention; types are named with `typeid`, so this
+// mode needs RTTI. Without the macro the hooks are empty and nothing is stored.
+#ifdef SMART_POINTERS_ACCOUNTING
+inline constexpr bool kAccountBlocks = true;
+#else
+inline constexpr bool kAccountBlocks = false;
+#endif
+
+struct BlockStats {
+    const char* type;
+    int64_t live_blocks;
+    int64_t payload_bytes;
+    // Bytes of destroyed objects whose in-place block is still referenced weakly. Recorded by
+    // the control block at the same points as `WeakPinnedBytes()`.
+    int64_t weak_pinned_bytes;
+};
+
+// Counter split over cache-line-sized shards. Writers touch the shard of their thread, readers
+// sum all of them, so individual shards may be negative.
+class ShardedCounter {
+public:
+    static constexpr size_t kShards = 16;
+
+    void Add(int64_t delta) {
+        shards_[ShardIndex()].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    int64_t Sum() const {
+        int64_t sum = 0;
+        for (const Shard& shard : shards_) {
+            sum += shard.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<int64_t> value = 0;
+    };
+
+    static size_t ShardIndex() {
+        static std::atomic<size_t> next_index = 0;
+        static thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+        return index % kShards;
+    }
+
+    Shard shards_[kShards];
+};
+
+// Statistics of one type. Registered on first use and never freed.
+class BlockStatsEntry {
+public:
+    explicit BlockStatsEntry(const char* type) : type_(type) {
+        next_ = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(next_, this, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    BlockStats Stats() const {
+        return {type_, live_blocks.Sum(), payload_bytes.Sum(), weak_pinned_bytes.Sum()};
+    }
+
+    static const BlockStatsEntry* First() {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    const BlockStatsEntry* Next() const {
+        return next_;
+    }
+
+    ShardedCounter live_blocks;
+    ShardedCounter payload_bytes;
+    ShardedCounter weak_pinned_bytes;
+
+private:
+    static inline std::atomic<BlockStatsEntry*> head_ = nullptr;
+
+    const char* type_;
+    BlockStatsEntry* next_;
+};
+
+// Hooks called by the control blocks (sw_fwd.h) for blocks holding `count` objects of type `T`.
+template <typename T>
+class BlockAccounting {
+public:
+    static void Created(size_t count) {
+        if constexpr (kAccountBlocks) {
+            Entry().live_blocks.Add(1);
+            Entry().payload_bytes.Add(Bytes(count));
+        }
+    }
+
+    static void Destroyed(size_t count) {
+        if constexpr (kAccountBlocks) {
+            Entry().payload_bytes.Add(-Bytes(count));
+        }
+    }
+
+    static void Freed() {
+        if constexpr (kAccountBlocks) {
+            Entry().live_blocks.Add(-1);
+        }
+    }
+
+    // A block outlived its object because of weak references (`bytes > 0`), or the last of them
+    // is gone (`bytes < 0`).
+    static void Pinned(int64_t bytes) {
+        if constexpr (kAccountBlocks) {
+            if (bytes != 0) {
+                Entry().weak_pinned_bytes.Add(bytes);
+            }
+        }
+    }
+
+    static BlockStats Stats() {
+        return Entry().Stats();
+    }
+
+private:
+    static BlockStatsEntry& Entry() {
+        static BlockStatsEntry entry(typeid(T).name());
+        return entry;
+    }
+
+    static int64_t Bytes(size_t count) {
+        if constexpr (std::is_void_v<T>) {
+            return 0;
+        } else {
+            return static_cast<int64_t>(count * sizeof(T));
+        }
+    }
+};
+
+// Statistics of every type that has had a block so far.
+inline std::vector<BlockStats> SnapshotBlockStats() {
+    std::vector<BlockStats> stats;
+    for (const BlockStatsEntry* entry = BlockStatsEntry::First(); entry != nullptr;
+         entry = entry->Next()) {
+        stats.push_back(entry->Stats());
+    }
+    return stats;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// Lock-free atomic `SharedPtr` slot (split reference counting).
+//
+// The stored value lives in a small node. The slot keeps a single 64-bit word: the node address
+// in the low 48 bits and the number of readers currently borrowing that node in the high 16 bits.
+// A reader bumps the borrow count with one `fetch_add`, copies the `SharedPtr` out of the node and
+// gives the borrow back. Whoever replaces the node transfers the outstanding borrows into the
+// node's own counter, and the last of them frees it. All operations are lock-free, not wait-free:
+// giving a borrow back is a CAS that retries whenever another reader or a writer changed the word
+// in between.
+//
+// Node addresses must fit in 48 bits. That is the case for 4-level paging user space, but not for
+// 5-level paging (LA57) or tagged heap pointers (AArch64 TBI, MTE); storing such a node aborts.
+//
+// Copies handed out by `Load` are shared between threads, so `Counter` has to be thread-safe.
+template <typename T, typename Counter>
+class AtomicSharedPtr {
+public:
+    using Pointer = SharedPtr<T, Counter>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AtomicSharedPtr() = default;
+
+    AtomicSharedPtr(Pointer desired) : word_(MakeWord(MakeNode(std::move(desired)))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~AtomicSharedPtr() {
+        Retire(word_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Atomic operations
+
+    Pointer Load() const {
+        uint64_t word = word_.fetch_add(kOneBorrow, std::memory_order_acquire);
+        Node* node = NodeOf(word);
+        Pointer result;
+        if (node != nullptr) {
+            result = node->value;
+        }
+        GiveBack(node);
+        return result;
+    }
+
+    void Store(Pointer desired) {
+        uint64_t word = word_.exchange(MakeWord(MakeNode(std::move(desired))),
+                                       std::memory_order_acq_rel);
+        Retire(word);
+    }
+
+    Pointer Exchange(Pointer desired) {
+        uint64_t word = word_.exchange(MakeWord(MakeNode(std::move(desired))),
+                                       std::memory_order_acq_rel);
+        Pointer result;
+        if (Node* node = NodeOf(word)) {
+            // Late readers may still be copying `node->value`, so it cannot be moved out.
+            result = node->value;
+        }
+        Retire(word);
+        return result;
+    }
+
+    // Replaces the value with `desired` if it holds the same pointer and control block as
+    // `expected`. Otherwise loads the current value into `expected` and returns `false`.
+    bool CompareExchange(Pointer& expected, Pointer desired) {
+        Node* desired_node = MakeNode(std::move(desired));
+        for (;;) {
+            uint64_t word = word_.fetch_add(kOneBorrow, std::memory_order_acquire);
+            Node* node = NodeOf(word);
+            if (!Equals(node, expected)) {
+                expected = (node != nullptr ? node->value : Pointer());
+                GiveBack(node);
+                delete desired_node;
+                return false;
+            }
+
+            word = word_.load(std::memory_order_relaxed);
+            while (NodeOf(word) == node) {
+                if (word_.compare_exchange_weak(word, MakeWord(desired_node),
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                    // Our own borrow was transferred together with the others.
+                    Retire(word);
+                    DropTransferred(node);
+                    return true;
+                }
+            }
+            // Replaced under our feet, compare against the new value.
+            GiveBack(node);
+        }
+    }
+
+    bool IsLockFree() const {
+        return word_.is_lock_free();
+    }
+
+private:
+    struct Node {
+        explicit Node(Pointer&& pointer) : value(std::move(pointer)) {
+        }
+
+        Pointer value;
+        // Borrows transferred by the writer that replaced the node minus the ones given back since.
+        // Whoever brings it to zero frees the node.
+        std::atomic<int64_t> transferred = 0;
+    };
+
+    static_assert(sizeof(void*) == sizeof(uint64_t), "AtomicSharedPtr packs 48-bit addresses");
+
+    static constexpr int kBorrowShift = 48;
+    static constexpr uint64_t kOneBorrow = uint64_t{1} << kBorrowShift;
+    static constexpr uint64_t kNodeMask = kOneBorrow - 1;
+
+    static Node* MakeNode(Pointer&& pointer) {
+        if (!pointer.control_block_ && pointer.ptr_ == nullptr) {
+            return nullptr;
+        }
+        return new Node(std::move(pointer));
+    }
+
+    static uint64_t MakeWord(Node* node) {
+        uint64_t address = reinterpret_cast<uint64_t>(node);
+        if ((address & ~kNodeMask) != 0) {
+            std::fprintf(stderr, "AtomicSharedPtr: node address %p does not fit in 48 bits\n",
+                         static_cast<void*>(node));
+            std::abort();
+        }
+        return address;
+    }
+
+    static Node* NodeOf(uint64_t word) {
+        return reinterpret_cast<Node*>(word & kNodeMask);
+    }
+
+    static int64_t BorrowsOf(uint64_t word) {
+        return static_cast<int64_t>(word >> kBorrowShift);
+    }
+
+    static bool Equals(Node* node, const Pointer& pointer) {
+        if (node == nullptr) {
+            return !pointer.control_block_ && pointer.ptr_ == nullptr;
+        }
+        return node->value.control_block_ == pointer.control_block_ &&
+               node->value.ptr_ == pointer.ptr_;
+    }
+
+    // Return a borrow taken on `node`: undo our increment if the node is still installed,
+    // otherwise settle with the writer that transferred it. Borrows of an empty slot pin nothing
+    // and are simply dropped when the slot is overwritten.
+    void GiveBack(Node* node) const {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        while (NodeOf(word) == node) {
+            if (node == nullptr && BorrowsOf(word) == 0) {
+                return;
+            }
+            if (word_.compare_exchange_weak(word, word - kOneBorrow, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        DropTransferred(node);
+    }
+
+    static void DropTransferred(Node* node) {
+        if (node != nullptr && node->transferred.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    // `word` was just swapped out of the slot.
+    static void Retire(uint64_t word) {
+        Node* node = NodeOf(word);
+        if (node == nullptr) {
+            return;
+        }
+        int64_t borrows = BorrowsOf(word);
+        if (node->transferred.fetch_add(borrows, std::memory_order_acq_rel) + borrows == 0) {
+            delete node;
+        }
+    }
+
+    mutable std::atomic<uint64_t> word_ = 0;
+};
@@ -0,0 +1,61 @@
+// Cost of per-type block accounting (accounting.h). Built into the main suite, where the hooks are
+// empty, and into the `accounting` suite with SMART_POINTERS_ACCOUNTING; compare the two by group.
+
+#include "harness.h"
+
+#include "accounting.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdint>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+struct Large {
+    int64_t value = 1;
+    char data[256];
+};
+
+// Creation and destruction, which update the live block and byte counts.
+template <typename T, typename Counter>
+void MakeDestroy(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<T, Counter> ptr = MakeShared<T, Counter>();
+        DoNotOptimize(ptr);
+    }
+}
+
+// A block that outlives its object, which also records and removes its weak-pinned bytes.
+void WeakPinned(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        WeakPtr<Large> weak;
+        {
+            SharedPtr<Large> ptr = MakeShared<Large>();
+            weak = ptr;
+        }
+        DoNotOptimize(weak);
+    }
+}
+
+// All threads create blocks of the same type, so any shared counter would be contended.
+void MakeDestroyContended(BenchState& state) {
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            SharedPtr<Payload, AtomicCounter> ptr = MakeShared<Payload, AtomicCounter>();
+            DoNotOptimize(ptr);
+        }
+    });
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"accounting_make_destroy", "SharedPtr", &MakeDestroy<Payload, SimpleCounter>},
+    {"accounting_make_destroy", "SharedPtr<AtomicCounter>", &MakeDestroy<Payload, AtomicCounter>},
+    {"accounting_weak_pinned", "SharedPtr", &WeakPinned},
+    {"accounting_make_contended", "SharedPtr<AtomicCounter>", &MakeDestroyContended, true},
+};
+
+}  // namespace
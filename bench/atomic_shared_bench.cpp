@@ -0,0 +1,133 @@
+// Readers loading a published `SharedPtr` (atomic_shared.h) against a mutex-guarded slot and the
+// `std::atomic_load` overloads for `std::shared_ptr`.
+
+#include "harness.h"
+
+#include "atomic_shared.h"
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+struct Table {
+    int64_t version = 1;
+};
+
+using Shared = SharedPtr<Table, AtomicCounter>;
+
+class AtomicSlot {
+public:
+    using Ptr = Shared;
+
+    static Ptr Make() {
+        return MakeShared<Table, AtomicCounter>();
+    }
+
+    Ptr Load() const {
+        return slot_.Load();
+    }
+
+    void Store(Ptr ptr) {
+        slot_.Store(std::move(ptr));
+    }
+
+private:
+    AtomicSharedPtr<Table> slot_;
+};
+
+class MutexSlot {
+public:
+    using Ptr = Shared;
+
+    static Ptr Make() {
+        return MakeShared<Table, AtomicCounter>();
+    }
+
+    Ptr Load() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slot_;
+    }
+
+    // The old value is released after unlocking, when `ptr` goes away.
+    void Store(Ptr ptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot_.Swap(ptr);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    Shared slot_;
+};
+
+class StdAtomicSlot {
+public:
+    using Ptr = std::shared_ptr<Table>;
+
+    static Ptr Make() {
+        return std::make_shared<Table>();
+    }
+
+    Ptr Load() const {
+        return std::atomic_load(&slot_);
+    }
+
+    void Store(Ptr ptr) {
+        std::atomic_store(&slot_, std::move(ptr));
+    }
+
+private:
+    std::shared_ptr<Table> slot_;
+};
+
+// `Threads()` readers load the slot while it is never written.
+template <typename Slot>
+void Load(BenchState& state) {
+    Slot slot;
+    slot.Store(Slot::Make());
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            typename Slot::Ptr ptr = slot.Load();
+            DoNotOptimize(ptr);
+        }
+    });
+}
+
+// The same with one more thread publishing a new value as fast as it can.
+template <typename Slot>
+void LoadWithWriter(BenchState& state) {
+    Slot slot;
+    slot.Store(Slot::Make());
+    std::atomic<bool> done = false;
+    std::thread writer([&] {
+        while (!done.load(std::memory_order_relaxed)) {
+            slot.Store(Slot::Make());
+        }
+    });
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            typename Slot::Ptr ptr = slot.Load();
+            DoNotOptimize(ptr);
+        }
+    });
+    done.store(true, std::memory_order_relaxed);
+    writer.join();
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"published_load", "AtomicSharedPtr", &Load<AtomicSlot>, true},
+    {"published_load", "mutex + SharedPtr", &Load<MutexSlot>, true},
+    {"published_load", "std::atomic_load(shared_ptr)", &Load<StdAtomicSlot>, true},
+
+    {"published_load_with_writer", "AtomicSharedPtr", &LoadWithWriter<AtomicSlot>, true},
+    {"published_load_with_writer", "mutex + SharedPtr", &LoadWithWriter<MutexSlot>, true},
+    {"published_load_with_writer", "std::atomic_load(shared_ptr)", &LoadWithWriter<StdAtomicSlot>,
+     true},
+};
+
+}  // namespace
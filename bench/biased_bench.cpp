@@ -0,0 +1,61 @@
+// Biased reference counting (biased.h) against a fully atomic counter, on the owner thread and
+// on another thread.
+
+#include "harness.h"
+
+#include "biased.h"
+#include "shared.h"
+
+#include <cstdint>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+// Copies made by the thread that created the object.
+template <typename Counter>
+void OwnerCopy(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> copy(ptr);
+        DoNotOptimize(copy);
+    }
+}
+
+// Copies made by another thread while the creator keeps its reference.
+template <typename Counter>
+void ForeignCopy(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            SharedPtr<Payload, Counter> copy(ptr);
+            DoNotOptimize(copy);
+        }
+    });
+}
+
+// Creation and release on the owner thread, where the merge on release happens.
+template <typename Counter>
+void OwnerMake(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+        DoNotOptimize(ptr);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"biased_owner_copy", "BiasedCounter", &OwnerCopy<BiasedCounter>},
+    {"biased_owner_copy", "AtomicCounter", &OwnerCopy<AtomicCounter>},
+    {"biased_owner_copy", "SimpleCounter", &OwnerCopy<SimpleCounter>},
+
+    {"biased_foreign_copy", "BiasedCounter", &ForeignCopy<BiasedCounter>, true},
+    {"biased_foreign_copy", "AtomicCounter", &ForeignCopy<AtomicCounter>, true},
+
+    {"biased_owner_make", "BiasedCounter", &OwnerMake<BiasedCounter>},
+    {"biased_owner_make", "AtomicCounter", &OwnerMake<AtomicCounter>},
+};
+
+}  // namespace
@@ -0,0 +1,113 @@
+// Control block allocation from `BlockPool` (block_pool.h) against plain new/delete. The pool is
+// used through `PoolAllocator` here, which is what SMART_POINTERS_BLOCK_POOL plugs in by default.
+
+#include "harness.h"
+
+#include "block_pool.h"
+#include "shared.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+// Size of a `ControlBlockPointer` with a stateless deleter.
+constexpr size_t kBlockSize = 32;
+constexpr size_t kBatch = 4096;
+
+struct PoolHeap {
+    static void* Allocate() {
+        return BlockPool::Allocate(kBlockSize, alignof(std::max_align_t));
+    }
+    static void Deallocate(void* ptr) {
+        BlockPool::Deallocate(ptr, kBlockSize, alignof(std::max_align_t));
+    }
+};
+
+struct GlobalHeap {
+    static void* Allocate() {
+        return ::operator new(kBlockSize);
+    }
+    static void Deallocate(void* ptr) {
+        ::operator delete(ptr);
+    }
+};
+
+// One allocation and its free on the same thread, `kBatch` blocks live at a time.
+template <typename Heap>
+void AllocateFree(BenchState& state) {
+    std::vector<void*> blocks(kBatch);
+    for (size_t done = 0; done < state.Iterations(); done += kBatch) {
+        size_t count = std::min(kBatch, state.Iterations() - done);
+        for (size_t i = 0; i < count; ++i) {
+            blocks[i] = Heap::Allocate();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Heap::Deallocate(blocks[i]);
+        }
+    }
+}
+
+// Blocks allocated here and freed by another thread, which the pool batches back to the owner.
+template <typename Heap>
+void RemoteFree(BenchState& state) {
+    std::vector<void*> blocks(kBatch);
+    for (size_t done = 0; done < state.Iterations(); done += kBatch) {
+        size_t count = std::min(kBatch, state.Iterations() - done);
+        for (size_t i = 0; i < count; ++i) {
+            blocks[i] = Heap::Allocate();
+        }
+        std::thread([&] {
+            for (size_t i = 0; i < count; ++i) {
+                Heap::Deallocate(blocks[i]);
+            }
+        }).join();
+    }
+}
+
+// `SharedPtr(new T)` and its release: the block comes from the pool, the object from `new`.
+void PointerBlockPool(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload> ptr(new Payload(), DefaultDeleter<Payload>(), PoolAllocator<Payload>());
+        DoNotOptimize(ptr);
+    }
+}
+
+void PointerBlockGlobal(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload> ptr(new Payload(), DefaultDeleter<Payload>(), std::allocator<Payload>());
+        DoNotOptimize(ptr);
+    }
+}
+
+template <typename Alloc>
+void InPlaceBlock(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload> ptr = AllocateShared<Payload, SimpleCounter>(Alloc());
+        DoNotOptimize(ptr);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"block_allocate_free", "BlockPool", &AllocateFree<PoolHeap>},
+    {"block_allocate_free", "operator new", &AllocateFree<GlobalHeap>},
+
+    {"block_remote_free", "BlockPool", &RemoteFree<PoolHeap>},
+    {"block_remote_free", "operator new", &RemoteFree<GlobalHeap>},
+
+    {"pointer_block", "PoolAllocator", &PointerBlockPool},
+    {"pointer_block", "std::allocator", &PointerBlockGlobal},
+
+    {"in_place_block", "PoolAllocator", &InPlaceBlock<PoolAllocator<Payload>>},
+    {"in_place_block", "std::allocator", &InPlaceBlock<std::allocator<Payload>>},
+};
+
+}  // namespace
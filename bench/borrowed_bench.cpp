@@ -0,0 +1,104 @@
+// Passing an object down a call chain as `Borrowed` (borrowed.h), as `const SharedPtr&`, by value
+// and as a raw pointer. Built into the main suite and into the `borrow_check` suite with
+// SMART_POINTERS_CHECK_BORROWS, which shows the cost of the debug mode.
+
+#include "harness.h"
+
+#include "borrowed.h"
+#include "intrusive.h"
+#include "shared.h"
+
+#include <cstdint>
+
+// Keeps every hop of the chain a real call that gets its parameter as declared. GCC would otherwise
+// rewrite the hops of the pointer and reference chains to take the loaded value instead (IPA-SRA),
+// which it does not do for class types passed by value.
+#if defined(__GNUC__) && !defined(__clang__)
+#define BENCH_NOINLINE __attribute__((noipa))
+#elif defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE
+#endif
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+struct IntrusivePayload : ThreadSafeRefCounted<IntrusivePayload> {
+    int64_t value = 1;
+};
+
+using Shared = SharedPtr<Payload, AtomicCounter>;
+using Intrusive = IntrusivePtr<IntrusivePayload>;
+
+constexpr int kDepth = 4;
+
+// Each hop reads the object and passes it on as it got it. Every depth is a function of its own,
+// so the recursion cannot be turned into a loop.
+template <typename Param, int Depth>
+BENCH_NOINLINE int64_t Hop(Param param) {
+    int64_t value = param->value;
+    if constexpr (Depth == 0) {
+        return value;
+    } else {
+        return value + Hop<Param, Depth - 1>(param);
+    }
+}
+
+template <typename Owner>
+Owner MakeOwner();
+
+template <>
+Shared MakeOwner<Shared>() {
+    return MakeShared<Payload, AtomicCounter>();
+}
+
+template <>
+Intrusive MakeOwner<Intrusive>() {
+    return MakeIntrusive<IntrusivePayload>();
+}
+
+// One iteration is one call chain of `kDepth + 1` calls. The owner escapes before each, so the
+// chain cannot be hoisted out of the loop.
+template <typename Owner, typename Param>
+void CallChain(BenchState& state) {
+    Owner owner = MakeOwner<Owner>();
+    state.ResetTimer();
+    int64_t sum = 0;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        DoNotOptimize(owner);
+        sum += Hop<Param, kDepth>(owner);
+    }
+    DoNotOptimize(sum);
+}
+
+template <typename Owner>
+void RawCallChain(BenchState& state) {
+    Owner owner = MakeOwner<Owner>();
+    state.ResetTimer();
+    int64_t sum = 0;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        DoNotOptimize(owner);
+        sum += Hop<decltype(owner.Get()), kDepth>(owner.Get());
+    }
+    DoNotOptimize(sum);
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"param_shared", "Borrowed", &CallChain<Shared, Borrowed<Payload>>},
+    {"param_shared", "const SharedPtr&", &CallChain<Shared, const Shared&>},
+    {"param_shared", "SharedPtr by value", &CallChain<Shared, Shared>},
+    {"param_shared", "T*", &RawCallChain<Shared>},
+
+    {"param_intrusive", "Borrowed", &CallChain<Intrusive, Borrowed<IntrusivePayload>>},
+    {"param_intrusive", "const IntrusivePtr&", &CallChain<Intrusive, const Intrusive&>},
+    {"param_intrusive", "IntrusivePtr by value", &CallChain<Intrusive, Intrusive>},
+    {"param_intrusive", "T*", &RawCallChain<Intrusive>},
+};
+
+}  // namespace
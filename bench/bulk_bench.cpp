@@ -0,0 +1,95 @@
+// `BulkCopy` / `BulkReset` (bulk.h) against element-wise copies and resets, for ranges pointing at
+// a few hot objects and at all distinct ones.
+
+#include "harness.h"
+
+#include "bulk.h"
+#include "intrusive.h"
+#include "shared.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+struct IntrusivePayload : ThreadSafeRefCounted<IntrusivePayload> {
+    int64_t value = 1;
+};
+
+constexpr size_t kRange = 4096;
+constexpr size_t kHotTargets = 8;
+
+using Shared = SharedPtr<Payload, AtomicCounter>;
+using Intrusive = IntrusivePtr<IntrusivePayload>;
+
+template <typename Ptr>
+Ptr MakeTarget() {
+    if constexpr (std::is_same_v<Ptr, Shared>) {
+        return MakeShared<Payload, AtomicCounter>();
+    } else {
+        return MakeIntrusive<IntrusivePayload>();
+    }
+}
+
+// `kRange` pointers to `targets` distinct objects, in random order.
+template <typename Ptr>
+std::vector<Ptr> MakeRange(size_t targets) {
+    std::vector<Ptr> objects;
+    for (size_t i = 0; i < targets; ++i) {
+        objects.push_back(MakeTarget<Ptr>());
+    }
+    XorShift random;
+    std::vector<Ptr> range;
+    for (size_t i = 0; i < kRange; ++i) {
+        range.push_back(i < targets ? objects[i] : objects[random.Next() % targets]);
+    }
+    return range;
+}
+
+// One iteration copies one element of the range into another range and resets the copy again.
+template <typename Ptr, size_t Targets>
+void ElementWise(BenchState& state) {
+    std::vector<Ptr> source = MakeRange<Ptr>(Targets);
+    std::vector<Ptr> copy(kRange);
+    state.ResetTimer();
+    for (size_t done = 0; done < state.Iterations(); done += kRange) {
+        size_t count = std::min(kRange, state.Iterations() - done);
+        std::copy(source.begin(), source.begin() + count, copy.begin());
+        for (size_t i = 0; i < count; ++i) {
+            copy[i].Reset();
+        }
+    }
+}
+
+template <typename Ptr, size_t Targets>
+void Bulk(BenchState& state) {
+    std::vector<Ptr> source = MakeRange<Ptr>(Targets);
+    std::vector<Ptr> copy(kRange);
+    state.ResetTimer();
+    for (size_t done = 0; done < state.Iterations(); done += kRange) {
+        size_t count = std::min(kRange, state.Iterations() - done);
+        BulkCopy(source.begin(), source.begin() + count, copy.begin());
+        BulkReset(copy.begin(), copy.begin() + count);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"bulk_copy_skewed", "SharedPtr<AtomicCounter> element-wise",
+     &ElementWise<Shared, kHotTargets>},
+    {"bulk_copy_skewed", "SharedPtr<AtomicCounter> BulkCopy", &Bulk<Shared, kHotTargets>},
+    {"bulk_copy_skewed", "IntrusivePtr element-wise", &ElementWise<Intrusive, kHotTargets>},
+    {"bulk_copy_skewed", "IntrusivePtr BulkCopy", &Bulk<Intrusive, kHotTargets>},
+
+    {"bulk_copy_uniform", "SharedPtr<AtomicCounter> element-wise", &ElementWise<Shared, kRange>},
+    {"bulk_copy_uniform", "SharedPtr<AtomicCounter> BulkCopy", &Bulk<Shared, kRange>},
+    {"bulk_copy_uniform", "IntrusivePtr element-wise", &ElementWise<Intrusive, kRange>},
+    {"bulk_copy_uniform", "IntrusivePtr BulkCopy", &Bulk<Intrusive, kRange>},
+};
+
+}  // namespace
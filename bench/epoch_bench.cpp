@@ -0,0 +1,73 @@
+// Read-mostly traversal of a shared chain: counted hops with `IntrusivePtr` copies against plain
+// pointers inside an `EpochGuard` (epoch.h).
+
+#include "harness.h"
+
+#include "epoch.h"
+#include "intrusive.h"
+
+#include <cstdint>
+#include <utility>
+
+namespace {
+
+constexpr size_t kChainLength = 64;
+
+struct alignas(64) CountedNode : ThreadSafeRefCounted<CountedNode> {
+    IntrusivePtr<CountedNode> next;
+    int64_t value = 1;
+};
+
+struct alignas(64) EpochNode : ThreadSafeRefCounted<EpochNode, EpochRetire<>> {
+    IntrusivePtr<EpochNode> next;
+    int64_t value = 1;
+};
+
+template <typename Node>
+IntrusivePtr<Node> MakeChain() {
+    IntrusivePtr<Node> head;
+    for (size_t i = 0; i < kChainLength; ++i) {
+        IntrusivePtr<Node> node = MakeIntrusive<Node>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+// One iteration walks the whole chain, taking a reference on every hop.
+void CountedTraversal(BenchState& state) {
+    IntrusivePtr<CountedNode> head = MakeChain<CountedNode>();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            int64_t sum = 0;
+            for (IntrusivePtr<CountedNode> node = head; node; node = node->next) {
+                sum += node->value;
+            }
+            DoNotOptimize(sum);
+        }
+    });
+}
+
+// One iteration walks the whole chain inside one critical section, without counter traffic.
+void EpochTraversal(BenchState& state) {
+    IntrusivePtr<EpochNode> head = MakeChain<EpochNode>();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            EpochGuard guard;
+            int64_t sum = 0;
+            for (const EpochNode* node = head.Get(); node; node = node->next.Get()) {
+                sum += node->value;
+            }
+            DoNotOptimize(sum);
+        }
+    });
+    head.Reset();
+    EpochDomain::Synchronize();
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"chain_traversal", "IntrusivePtr copies", &CountedTraversal, true},
+    {"chain_traversal", "EpochGuard", &EpochTraversal, true},
+};
+
+}  // namespace
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+// Property of a benchmark run other than its time, see `BenchState::SetCounter`.
+struct BenchCounter {
+    const char* name;
+    double value;
+};
+
+// Self-contained benchmark harness, no dependencies beyond the standard library.
+//
+//     void CopyShared(BenchState& state) {
+//         SharedPtr<int> ptr = MakeShared<int>();
+//         state.ResetTimer();
+//         for (size_t i = 0; i < state.Iterations(); ++i) {
+//             SharedPtr<int> copy(ptr);
+//             DoNotOptimize(copy);
+//         }
+//     }
+//
+//     const RegisterBenchmarks kBenchmarks = {{"copy", "SharedPtr", &CopyShared}};
+//
+// Each benchmark is a function running `Iterations()` operations; the harness grows the count
+// until one run takes at least `--min-time` and reports the median of `--repetitions` runs.
+// Threaded benchmarks run `Iterations()` operations on each of `Threads()` threads (see
+// `RunOnThreads`), for thread counts doubling from 1 up to `--max-threads`. Results are written
+// as CSV (default) or JSON, one record per benchmark and thread count, so runs of two versions
+// can be compared mechanically. Benchmarks may add counters (`SetCounter`), e.g. bytes in use.
+class BenchState {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BenchState(size_t iterations, size_t threads)
+        : iterations_(iterations), threads_(threads), start_(Clock::now()), stop_(start_) {
+    }
+
+    // Operations to run, on each thread for threaded benchmarks.
+    size_t Iterations() const {
+        return iterations_;
+    }
+
+    size_t Threads() const {
+        return threads_;
+    }
+
+    // Restart the clock, e.g. once the input of the measured loop is built.
+    void ResetTimer() {
+        start_ = Clock::now();
+        paused_ = Clock::duration::zero();
+        stopped_ = false;
+    }
+
+    // Leave the time between `PauseTimer` and `ResumeTimer` out, e.g. to rebuild the input between
+    // batches. Each pair costs two clock reads, so pause per batch rather than per operation.
+    void PauseTimer() {
+        pause_start_ = Clock::now();
+    }
+
+    void ResumeTimer() {
+        paused_ += Clock::now() - pause_start_;
+    }
+
+    // Stop the clock before tearing down what should not be measured. Otherwise it stops when
+    // the benchmark function returns.
+    void StopTimer() {
+        if (!stopped_) {
+            stop_ = Clock::now();
+            stopped_ = true;
+        }
+    }
+
+    Clock::duration Elapsed() const {
+        return stop_ - start_ - paused_;
+    }
+
+    // Report `value` under `name` next to the time, e.g. how much memory the subject held at the
+    // end. Setting the same name again overwrites it.
+    void SetCounter(const char* name, double value) {
+        for (BenchCounter& counter : counters_) {
+            if (std::strcmp(counter.name, name) == 0) {
+                counter.value = value;
+                return;
+            }
+        }
+        counters_.push_back({name, value});
+    }
+
+    const std::vector<BenchCounter>& Counters() const {
+        return counters_;
+    }
+
+private:
+    size_t iterations_;
+    size_t threads_;
+    Clock::time_point start_;
+    Clock::time_point stop_;
+    Clock::time_point pause_start_;
+    Clock::duration paused_ = Clock::duration::zero();
+    bool stopped_ = false;
+    std::vector<BenchCounter> counters_;
+};
+
+using BenchFunction = void (*)(BenchState&);
+
+struct Benchmark {
+    // What is measured, e.g. "copy", and what with, e.g. "std::shared_ptr".
+    const char* group;
+    const char* subject;
+    BenchFunction function;
+    bool threaded = false;
+};
+
+class BenchRegistry {
+public:
+    static std::vector<Benchmark>& All() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+};
+
+// Adds benchmarks to the registry during static initialization.
+struct RegisterBenchmarks {
+    RegisterBenchmarks(std::initializer_list<Benchmark> benchmarks) {
+        BenchRegistry::All().insert(BenchRegistry::All().end(), benchmarks);
+    }
+};
+
+// Keep the compiler from optimizing `value` (and the work that produced it) away.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Run `body(thread_index)` on `state.Threads()` threads at once. Only the time from the moment all
+// of them are ready until the last one is done is measured.
+template <typename Body>
+void RunOnThreads(BenchState& state, Body body) {
+    std::atomic<size_t> ready = 0;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < state.Threads(); ++i) {
+        threads.emplace_back([&, i] {
+            ready.fetch_add(1, std::memory_order_acq_rel);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            body(i);
+        });
+    }
+    while (ready.load(std::memory_order_acquire) != state.Threads()) {
+        std::this_thread::yield();
+    }
+    state.ResetTimer();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    state.StopTimer();
+}
+
+// Small deterministic generator for workloads, so every run and every subject sees the same
+// sequence.
+class XorShift {
+public:
+    explicit XorShift(uint64_t seed = 0x9E3779B97F4A7C15ull) : state_(seed) {
+    }
+
+    uint64_t Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+private:
+    uint64_t state_;
+};
@@ -0,0 +1,71 @@
+// `IntrusivePtr` with `ThreadSafeRefCounted` (intrusive.h): copies and destruction across 1..N
+// threads, on one shared object and on an object per thread.
+
+#include "harness.h"
+
+#include "intrusive.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// A cache line each, so objects of different threads never share one.
+struct alignas(64) SimpleNode : SimpleRefCounted<SimpleNode> {
+    int64_t value = 1;
+};
+
+struct alignas(64) AtomicNode : ThreadSafeRefCounted<AtomicNode> {
+    int64_t value = 1;
+};
+
+// Every thread copies and drops references to the same object.
+template <typename Node>
+void CopyShared(BenchState& state) {
+    IntrusivePtr<Node> node = MakeIntrusive<Node>();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            IntrusivePtr<Node> copy(node);
+            DoNotOptimize(copy);
+        }
+    });
+}
+
+// Every thread copies and drops references to an object of its own.
+template <typename Node>
+void CopyPrivate(BenchState& state) {
+    std::vector<IntrusivePtr<Node>> nodes;
+    for (size_t i = 0; i < state.Threads(); ++i) {
+        nodes.push_back(MakeIntrusive<Node>());
+    }
+    RunOnThreads(state, [&](size_t thread) {
+        const IntrusivePtr<Node>& node = nodes[thread];
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            IntrusivePtr<Node> copy(node);
+            DoNotOptimize(copy);
+        }
+    });
+}
+
+// Every thread creates objects and drops the last reference itself.
+template <typename Node>
+void MakeDestroy(BenchState& state) {
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            IntrusivePtr<Node> node = MakeIntrusive<Node>();
+            DoNotOptimize(node);
+        }
+    });
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"intrusive_copy_shared", "ThreadSafeRefCounted", &CopyShared<AtomicNode>, true},
+
+    {"intrusive_copy_private", "ThreadSafeRefCounted", &CopyPrivate<AtomicNode>, true},
+    {"intrusive_copy_private", "SimpleRefCounted", &CopyPrivate<SimpleNode>, true},
+
+    {"intrusive_make_destroy", "ThreadSafeRefCounted", &MakeDestroy<AtomicNode>, true},
+    {"intrusive_make_destroy", "SimpleRefCounted", &MakeDestroy<SimpleNode>, true},
+};
+
+}  // namespace
@@ -0,0 +1,121 @@
+// Weakly referenced objects with `WeakRefCounted` / `IntrusiveWeakPtr` (intrusive_weak.h) against
+// `SharedPtr` / `WeakPtr`, which need a control block for the same.
+
+#include "harness.h"
+
+#include "intrusive.h"
+#include "intrusive_weak.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdint>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+template <typename Counter>
+struct WeakNode : WeakRefCounted<WeakNode<Counter>, Counter> {
+    int64_t value = 1;
+};
+
+struct Node : SimpleRefCounted<Node> {
+    int64_t value = 1;
+};
+
+// How each subject makes an object that can be referenced weakly, and locks a weak reference.
+template <typename Counter>
+struct Intrusive {
+    using Ptr = IntrusivePtr<WeakNode<Counter>>;
+    using Weak = IntrusiveWeakPtr<WeakNode<Counter>>;
+
+    static Ptr Make() {
+        return MakeIntrusive<WeakNode<Counter>>();
+    }
+    static Ptr Lock(const Weak& weak) {
+        return weak.Lock();
+    }
+};
+
+template <typename Counter>
+struct Shared {
+    using Ptr = SharedPtr<Payload, Counter>;
+    using Weak = WeakPtr<Payload, Counter>;
+
+    static Ptr Make() {
+        return MakeShared<Payload, Counter>();
+    }
+    static Ptr Lock(const Weak& weak) {
+        return weak.Lock();
+    }
+};
+
+// `SharedPtr` to an object that was made with `new`, with a block of its own.
+template <typename Counter>
+struct SharedFromNew : Shared<Counter> {
+    static SharedPtr<Payload, Counter> Make() {
+        return SharedPtr<Payload, Counter>(new Payload());
+    }
+};
+
+template <typename Family>
+void Make(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        typename Family::Ptr ptr = Family::Make();
+        DoNotOptimize(ptr);
+    }
+}
+
+// Plain `IntrusivePtr`, which cannot be referenced weakly, for scale.
+void MakeNotWeak(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        IntrusivePtr<Node> ptr = MakeIntrusive<Node>();
+        DoNotOptimize(ptr);
+    }
+}
+
+template <typename Family>
+void Lock(BenchState& state) {
+    typename Family::Ptr ptr = Family::Make();
+    typename Family::Weak weak(ptr);
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        typename Family::Ptr locked = Family::Lock(weak);
+        DoNotOptimize(locked);
+    }
+}
+
+// One iteration makes an object and a weak reference to it, drops the object, fails to lock the
+// weak reference and drops it, which frees the memory.
+template <typename Family>
+void Lifecycle(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        typename Family::Weak weak;
+        {
+            typename Family::Ptr ptr = Family::Make();
+            weak = typename Family::Weak(ptr);
+        }
+        DoNotOptimize(Family::Lock(weak));
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"weak_capable_make", "WeakRefCounted", &Make<Intrusive<SimpleCounter>>},
+    {"weak_capable_make", "MakeShared", &Make<Shared<SimpleCounter>>},
+    {"weak_capable_make", "SharedPtr(new T)", &Make<SharedFromNew<SimpleCounter>>},
+    {"weak_capable_make", "RefCounted (no weak)", &MakeNotWeak},
+
+    {"intrusive_weak_lock", "IntrusiveWeakPtr", &Lock<Intrusive<SimpleCounter>>},
+    {"intrusive_weak_lock", "IntrusiveWeakPtr<AtomicCounter>", &Lock<Intrusive<AtomicCounter>>},
+    {"intrusive_weak_lock", "WeakPtr", &Lock<Shared<SimpleCounter>>},
+    {"intrusive_weak_lock", "WeakPtr<AtomicCounter>", &Lock<Shared<AtomicCounter>>},
+
+    {"weak_lifecycle", "IntrusiveWeakPtr", &Lifecycle<Intrusive<SimpleCounter>>},
+    {"weak_lifecycle", "IntrusiveWeakPtr<AtomicCounter>", &Lifecycle<Intrusive<AtomicCounter>>},
+    {"weak_lifecycle", "WeakPtr", &Lifecycle<Shared<SimpleCounter>>},
+    {"weak_lifecycle", "WeakPtr<AtomicCounter>", &Lifecycle<Shared<AtomicCounter>>},
+};
+
+}  // namespace
@@ -0,0 +1,218 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Name of the executable's configuration, set by bench/CMakeLists.txt.
+#ifndef SMART_POINTERS_BENCH_SUITE
+#define SMART_POINTERS_BENCH_SUITE "default"
+#endif
+
+namespace {
+
+constexpr double kMaxWallFactor = 20;
+
+struct Options {
+    bool json = false;
+    bool list = false;
+    const char* out = nullptr;
+    const char* filter = "";
+    const char* label = "";
+    double min_time_ms = 100;
+    size_t repetitions = 3;
+    size_t max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+};
+
+struct Result {
+    const Benchmark* benchmark;
+    size_t threads;
+    size_t iterations;
+    double ns_per_op;
+    // Of the last repetition.
+    std::vector<BenchCounter> counters;
+};
+
+const char* Value(const char* arg, const char* name) {
+    size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) == 0 && arg[length] == '=') {
+        return arg + length + 1;
+    }
+    return nullptr;
+}
+
+void Usage(const char* program) {
+    std::fprintf(stderr,
+                 "usage: %s [--format=csv|json] [--out=FILE] [--filter=SUBSTRING] [--label=TEXT]\n"
+                 "          [--min-time=MS] [--repetitions=N] [--max-threads=N] [--list]\n",
+                 program);
+    std::exit(2);
+}
+
+Options Parse(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (const char* value = Value(arg, "--format")) {
+            if (std::strcmp(value, "json") != 0 && std::strcmp(value, "csv") != 0) {
+                Usage(argv[0]);
+            }
+            options.json = (std::strcmp(value, "json") == 0);
+        } else if (const char* value = Value(arg, "--out")) {
+            options.out = value;
+        } else if (const char* value = Value(arg, "--filter")) {
+            options.filter = value;
+        } else if (const char* value = Value(arg, "--label")) {
+            options.label = value;
+        } else if (const char* value = Value(arg, "--min-time")) {
+            options.min_time_ms = std::atof(value);
+        } else if (const char* value = Value(arg, "--repetitions")) {
+            options.repetitions = std::max(1, std::atoi(value));
+        } else if (const char* value = Value(arg, "--max-threads")) {
+            options.max_threads = std::max(1, std::atoi(value));
+        } else if (std::strcmp(arg, "--list") == 0) {
+            options.list = true;
+        } else {
+            Usage(argv[0]);
+        }
+    }
+    return options;
+}
+
+std::string FullName(const Benchmark& benchmark) {
+    return std::string(benchmark.group) + "/" + benchmark.subject;
+}
+
+double Nanoseconds(BenchState::Clock::duration duration) {
+    return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+struct Run {
+    double elapsed_ns;
+    double wall_ns;
+    std::vector<BenchCounter> counters;
+};
+
+Run RunOnce(const Benchmark& benchmark, size_t iterations, size_t threads) {
+    BenchState::Clock::time_point start = BenchState::Clock::now();
+    BenchState state(iterations, threads);
+    benchmark.function(state);
+    state.StopTimer();
+    return {Nanoseconds(state.Elapsed()), Nanoseconds(BenchState::Clock::now() - start),
+            state.Counters()};
+}
+
+Result Measure(const Benchmark& benchmark, size_t threads, const Options& options) {
+    double min_time_ns = options.min_time_ms * 1e6;
+    // Benchmarks that pause the timer for most of their run stop growing here, so their untimed
+    // setup cannot take forever.
+    double max_wall_ns = std::max(1e9, kMaxWallFactor * min_time_ns);
+    size_t iterations = 1;
+    while (true) {
+        Run run = RunOnce(benchmark, iterations, threads);
+        if (run.elapsed_ns >= min_time_ns || run.wall_ns >= max_wall_ns ||
+            iterations >= (size_t{1} << 40)) {
+            break;
+        }
+        double factor = (run.elapsed_ns > 0 ? 1.4 * min_time_ns / run.elapsed_ns : 100);
+        if (run.wall_ns > 0) {
+            factor = std::min(factor, max_wall_ns / run.wall_ns);
+        }
+        iterations = static_cast<size_t>(iterations * std::clamp(factor, 2.0, 100.0));
+    }
+
+    std::vector<double> samples;
+    std::vector<BenchCounter> counters;
+    for (size_t i = 0; i < options.repetitions; ++i) {
+        Run run = RunOnce(benchmark, iterations, threads);
+        samples.push_back(run.elapsed_ns / iterations);
+        counters = std::move(run.counters);
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return {&benchmark, threads, iterations, samples[samples.size() / 2], std::move(counters)};
+}
+
+void WriteCsv(std::FILE* file, const std::vector<Result>& results, const Options& options) {
+    std::fprintf(file, "suite,label,group,subject,threads,iterations,ns_per_op,counters\n");
+    for (const Result& result : results) {
+        std::fprintf(file, "%s,\"%s\",%s,\"%s\",%zu,%zu,%.3f,\"", SMART_POINTERS_BENCH_SUITE,
+                     options.label, result.benchmark->group, result.benchmark->subject,
+                     result.threads, result.iterations, result.ns_per_op);
+        for (size_t i = 0; i < result.counters.size(); ++i) {
+            std::fprintf(file, "%s%s=%.17g", (i == 0 ? "" : ";"), result.counters[i].name,
+                         result.counters[i].value);
+        }
+        std::fprintf(file, "\"\n");
+    }
+}
+
+void WriteJson(std::FILE* file, const std::vector<Result>& results, const Options& options) {
+    std::fprintf(file, "{\n  \"suite\": \"%s\",\n  \"label\": \"%s\",\n  \"results\": [",
+                 SMART_POINTERS_BENCH_SUITE, options.label);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::fprintf(file,
+                     "%s\n    {\"group\": \"%s\", \"subject\": \"%s\", \"threads\": %zu, "
+                     "\"iterations\": %zu, \"ns_per_op\": %.3f, \"counters\": {",
+                     (i == 0 ? "" : ","), result.benchmark->group, result.benchmark->subject,
+                     result.threads, result.iterations, result.ns_per_op);
+        for (size_t j = 0; j < result.counters.size(); ++j) {
+            std::fprintf(file, "%s\"%s\": %.17g", (j == 0 ? "" : ", "), result.counters[j].name,
+                         result.counters[j].value);
+        }
+        std::fprintf(file, "}}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = Parse(argc, argv);
+
+    std::vector<const Benchmark*> selected;
+    for (const Benchmark& benchmark : BenchRegistry::All()) {
+        if (FullName(benchmark).find(options.filter) != std::string::npos) {
+            selected.push_back(&benchmark);
+        }
+    }
+    if (options.list) {
+        for (const Benchmark* benchmark : selected) {
+            std::printf("%s%s\n", FullName(*benchmark).c_str(),
+                        (benchmark->threaded ? " (threaded)" : ""));
+        }
+        return 0;
+    }
+
+    std::vector<Result> results;
+    for (const Benchmark* benchmark : selected) {
+        size_t max_threads = (benchmark->threaded ? options.max_threads : 1);
+        for (size_t threads = 1;; threads = std::min(2 * threads, max_threads)) {
+            results.push_back(Measure(*benchmark, threads, options));
+            std::fprintf(stderr, "%-56s %3zu thread(s) %12.2f ns/op\n",
+                         FullName(*benchmark).c_str(), threads, results.back().ns_per_op);
+            if (threads == max_threads) {
+                break;
+            }
+        }
+    }
+
+    std::FILE* file = (options.out != nullptr ? std::fopen(options.out, "w") : stdout);
+    if (file == nullptr) {
+        std::perror(options.out);
+        return 1;
+    }
+    if (options.json) {
+        WriteJson(file, results, options);
+    } else {
+        WriteCsv(file, results, options);
+    }
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}
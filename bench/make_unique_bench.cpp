@@ -0,0 +1,63 @@
+// `MakeUnique<T[]>` against `MakeUniqueForOverwrite<T[]>` for scratch buffers that are written
+// in full right after they are made, so the zero fill of the former is pure overhead.
+
+#include "harness.h"
+
+#include "unique.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+constexpr size_t kSmallBuffer = size_t{64} << 10;
+constexpr size_t kLargeBuffer = size_t{8} << 20;
+
+// The buffer escapes before it is written, so the compiler cannot drop an initial fill as a dead
+// store.
+template <size_t Bytes>
+void Overwrite(char* buffer, size_t i) {
+    DoNotOptimize(buffer);
+    std::memset(buffer, static_cast<int>(i), Bytes);
+}
+
+// One iteration makes a buffer of `Bytes`, overwrites it and frees it.
+template <size_t Bytes>
+void ValueInitialized(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        UniquePtr<char[]> buffer = MakeUnique<char[]>(Bytes);
+        Overwrite<Bytes>(&buffer[0], i);
+        DoNotOptimize(buffer[Bytes - 1]);
+    }
+}
+
+template <size_t Bytes>
+void ForOverwrite(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        UniquePtr<char[]> buffer = MakeUniqueForOverwrite<char[]>(Bytes);
+        Overwrite<Bytes>(&buffer[0], i);
+        DoNotOptimize(buffer[Bytes - 1]);
+    }
+}
+
+template <size_t Bytes>
+void StdValueInitialized(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(Bytes);
+        Overwrite<Bytes>(&buffer[0], i);
+        DoNotOptimize(buffer[Bytes - 1]);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"scratch_buffer_64k", "MakeUnique<T[]>", &ValueInitialized<kSmallBuffer>},
+    {"scratch_buffer_64k", "MakeUniqueForOverwrite<T[]>", &ForOverwrite<kSmallBuffer>},
+    {"scratch_buffer_64k", "std::make_unique<T[]>", &StdValueInitialized<kSmallBuffer>},
+
+    {"scratch_buffer_8m", "MakeUnique<T[]>", &ValueInitialized<kLargeBuffer>},
+    {"scratch_buffer_8m", "MakeUniqueForOverwrite<T[]>", &ForOverwrite<kLargeBuffer>},
+    {"scratch_buffer_8m", "std::make_unique<T[]>", &StdValueInitialized<kLargeBuffer>},
+};
+
+}  // namespace
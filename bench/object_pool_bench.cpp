@@ -0,0 +1,99 @@
+// Acquire/release through `ObjectPool` (object_pool.h) against creating and deleting the object
+// every time.
+
+#include "harness.h"
+
+#include "object_pool.h"
+#include "unique.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Expensive to make: owns a heap buffer, like a parse buffer.
+struct Buffer {
+    std::vector<char> data = std::vector<char>(4096);
+};
+
+struct ClearBuffer {
+    void operator()(Buffer& buffer) const {
+        buffer.data[0] = 0;
+    }
+};
+
+struct Small {
+    int64_t value = 1;
+};
+
+constexpr size_t kHeld = 256;
+
+template <typename T, typename Reset = NoReset>
+void Pooled(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        typename ObjectPool<T, Reset>::Ptr object = ObjectPool<T, Reset>::Acquire();
+        DoNotOptimize(object.Get());
+    }
+}
+
+template <typename T>
+void Fresh(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        UniquePtr<T> object = MakeUnique<T>();
+        DoNotOptimize(object.Get());
+    }
+}
+
+// One iteration acquires one object; `kHeld` are held at a time, more than a thread's cache.
+template <typename T, typename Reset = NoReset>
+void PooledHeld(BenchState& state) {
+    std::vector<typename ObjectPool<T, Reset>::Ptr> held;
+    held.reserve(kHeld);
+    for (size_t done = 0; done < state.Iterations(); done += kHeld) {
+        size_t count = std::min(kHeld, state.Iterations() - done);
+        for (size_t i = 0; i < count; ++i) {
+            held.push_back(ObjectPool<T, Reset>::Acquire());
+        }
+        held.clear();
+    }
+}
+
+template <typename T>
+void FreshHeld(BenchState& state) {
+    std::vector<UniquePtr<T>> held;
+    held.reserve(kHeld);
+    for (size_t done = 0; done < state.Iterations(); done += kHeld) {
+        size_t count = std::min(kHeld, state.Iterations() - done);
+        for (size_t i = 0; i < count; ++i) {
+            held.push_back(MakeUnique<T>());
+        }
+        held.clear();
+    }
+}
+
+// Every thread acquires and releases on its own.
+template <typename T, typename Reset = NoReset>
+void PooledThreads(BenchState& state) {
+    RunOnThreads(state, [&](size_t) { Pooled<T, Reset>(state); });
+}
+
+template <typename T>
+void FreshThreads(BenchState& state) {
+    RunOnThreads(state, [&](size_t) { Fresh<T>(state); });
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"pool_buffer", "ObjectPool", &Pooled<Buffer, ClearBuffer>},
+    {"pool_buffer", "MakeUnique", &Fresh<Buffer>},
+    {"pool_small", "ObjectPool", &Pooled<Small>},
+    {"pool_small", "MakeUnique", &Fresh<Small>},
+
+    {"pool_buffer_held", "ObjectPool", &PooledHeld<Buffer, ClearBuffer>},
+    {"pool_buffer_held", "MakeUnique", &FreshHeld<Buffer>},
+
+    {"pool_buffer_threads", "ObjectPool", &PooledThreads<Buffer, ClearBuffer>, true},
+    {"pool_buffer_threads", "MakeUnique", &FreshThreads<Buffer>, true},
+};
+
+}  // namespace
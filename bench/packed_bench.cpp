@@ -0,0 +1,125 @@
+// Control block layouts of packed.h against the default thread-safe one, on operations dominated
+// by the block: creation and teardown, copies, weak promotion and a whole tree.
+
+#include "harness.h"
+
+#include "packed.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+// Creation and destruction; the last release is where the packed word saves an RMW.
+template <typename Counter>
+void MakeDestroy(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+        DoNotOptimize(ptr);
+    }
+}
+
+// Many live blocks at once, so their size shows up in the cache footprint.
+template <typename Counter>
+void MakeMany(BenchState& state) {
+    std::vector<SharedPtr<Payload, Counter>> ptrs;
+    ptrs.reserve(state.Iterations());
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        ptrs.push_back(MakeShared<Payload, Counter>());
+    }
+    state.StopTimer();
+}
+
+template <typename Counter>
+void Copy(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> copy(ptr);
+        DoNotOptimize(copy);
+    }
+}
+
+template <typename Counter>
+void WeakLock(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    WeakPtr<Payload, Counter> weak(ptr);
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> locked = weak.Lock();
+        DoNotOptimize(locked);
+    }
+}
+
+// Every thread copies the same pointer.
+template <typename Counter>
+void CopyContended(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            SharedPtr<Payload, Counter> copy(ptr);
+            DoNotOptimize(copy);
+        }
+    });
+}
+
+constexpr int kTreeDepth = 12;
+
+template <typename Counter>
+struct TreeNode {
+    SharedPtr<TreeNode, Counter> left;
+    SharedPtr<TreeNode, Counter> right;
+};
+
+template <typename Counter>
+SharedPtr<TreeNode<Counter>, Counter> BuildTree(int depth) {
+    auto node = MakeShared<TreeNode<Counter>, Counter>();
+    if (depth > 1) {
+        node->left = BuildTree<Counter>(depth - 1);
+        node->right = BuildTree<Counter>(depth - 1);
+    }
+    return node;
+}
+
+// One iteration builds and tears down a tree of 2^kTreeDepth - 1 nodes.
+template <typename Counter>
+void Tree(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        auto root = BuildTree<Counter>(kTreeDepth);
+        DoNotOptimize(root);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"counts_make_destroy", "AtomicCounter", &MakeDestroy<AtomicCounter>},
+    {"counts_make_destroy", "PackedCounter", &MakeDestroy<PackedCounter>},
+    {"counts_make_destroy", "NoWeak<AtomicCounter>", &MakeDestroy<NoWeak<AtomicCounter>>},
+
+    {"counts_make_many", "AtomicCounter", &MakeMany<AtomicCounter>},
+    {"counts_make_many", "PackedCounter", &MakeMany<PackedCounter>},
+    {"counts_make_many", "NoWeak<AtomicCounter>", &MakeMany<NoWeak<AtomicCounter>>},
+
+    {"counts_copy", "AtomicCounter", &Copy<AtomicCounter>},
+    {"counts_copy", "PackedCounter", &Copy<PackedCounter>},
+    {"counts_copy", "NoWeak<AtomicCounter>", &Copy<NoWeak<AtomicCounter>>},
+
+    {"counts_weak_lock", "AtomicCounter", &WeakLock<AtomicCounter>},
+    {"counts_weak_lock", "PackedCounter", &WeakLock<PackedCounter>},
+
+    {"counts_copy_contended", "AtomicCounter", &CopyContended<AtomicCounter>, true},
+    {"counts_copy_contended", "PackedCounter", &CopyContended<PackedCounter>, true},
+    {"counts_copy_contended", "NoWeak<AtomicCounter>", &CopyContended<NoWeak<AtomicCounter>>,
+     true},
+
+    {"counts_tree", "AtomicCounter", &Tree<AtomicCounter>},
+    {"counts_tree", "PackedCounter", &Tree<PackedCounter>},
+    {"counts_tree", "NoWeak<AtomicCounter>", &Tree<NoWeak<AtomicCounter>>},
+};
+
+}  // namespace
@@ -0,0 +1,112 @@
+// Release of the last owner of a whole object graph, inline against deferred to `ReclaimQueue`
+// (reclaim.h). Only the release is timed, which is what the thread dropping the owner pays; the
+// queue is drained outside of the measurement.
+
+#include "harness.h"
+
+#include "intrusive.h"
+#include "reclaim.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr int kGraphDepth = 10;
+constexpr size_t kBatch = 64;
+
+// Complete binary tree of 2^kGraphDepth - 1 nodes, owned through plain `UniquePtr` links.
+struct GraphNode {
+    UniquePtr<GraphNode> left;
+    UniquePtr<GraphNode> right;
+    int64_t value = 1;
+};
+
+UniquePtr<GraphNode> BuildTree(int depth) {
+    UniquePtr<GraphNode> node = MakeUnique<GraphNode>();
+    if (depth > 1) {
+        node->left = BuildTree(depth - 1);
+        node->right = BuildTree(depth - 1);
+    }
+    return node;
+}
+
+struct Graph {
+    UniquePtr<GraphNode> root = BuildTree(kGraphDepth);
+};
+
+struct InlineIntrusiveGraph : SimpleRefCounted<InlineIntrusiveGraph> {
+    UniquePtr<GraphNode> root = BuildTree(kGraphDepth);
+};
+
+struct DeferredIntrusiveGraph : SimpleRefCounted<DeferredIntrusiveGraph, DeferredDelete<>> {
+    UniquePtr<GraphNode> root = BuildTree(kGraphDepth);
+};
+
+// How each subject takes ownership of a new graph.
+template <typename Ptr>
+struct Owner;
+
+template <typename Deleter>
+struct Owner<UniquePtr<Graph, Deleter>> {
+    static UniquePtr<Graph, Deleter> Make() {
+        return UniquePtr<Graph, Deleter>(new Graph());
+    }
+};
+
+template <>
+struct Owner<SharedPtr<Graph>> {
+    static SharedPtr<Graph> Make() {
+        return SharedPtr<Graph>(new Graph());
+    }
+};
+
+template <typename T>
+struct Owner<IntrusivePtr<T>> {
+    static IntrusivePtr<T> Make() {
+        return MakeIntrusive<T>();
+    }
+};
+
+struct DeferredSharedOwner {
+    static SharedPtr<Graph> Make() {
+        return SharedPtr<Graph>(new Graph(), DeferredDeleter<Graph>());
+    }
+};
+
+// One iteration drops the only owner of one graph. Graphs are built and the queue is drained in
+// batches with the timer paused.
+template <typename Ptr, typename Make = Owner<Ptr>>
+void Release(BenchState& state) {
+    std::vector<Ptr> owners;
+    owners.reserve(kBatch);
+    state.PauseTimer();
+    for (size_t done = 0; done < state.Iterations(); done += kBatch) {
+        size_t count = std::min(kBatch, state.Iterations() - done);
+        for (size_t i = 0; i < count; ++i) {
+            owners.push_back(Make::Make());
+        }
+        state.ResumeTimer();
+        owners.clear();
+        state.PauseTimer();
+        DrainReclaimQueue();
+    }
+    state.ResumeTimer();
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"graph_release", "UniquePtr", &Release<UniquePtr<Graph>>},
+    {"graph_release", "UniquePtr<DeferredDeleter>",
+     &Release<UniquePtr<Graph, DeferredDeleter<Graph>>>},
+    {"graph_release", "SharedPtr", &Release<SharedPtr<Graph>>},
+    {"graph_release", "SharedPtr(DeferredDeleter)",
+     &Release<SharedPtr<Graph>, DeferredSharedOwner>},
+    {"graph_release", "IntrusivePtr", &Release<IntrusivePtr<InlineIntrusiveGraph>>},
+    {"graph_release", "IntrusivePtr<DeferredDelete>",
+     &Release<IntrusivePtr<DeferredIntrusiveGraph>>},
+};
+
+}  // namespace
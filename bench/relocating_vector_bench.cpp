@@ -0,0 +1,134 @@
+// Growth and erasure of vectors of smart pointers: `RelocatingVector` (relocating_vector.h), which
+// moves them with `memcpy`, against `std::vector`, which moves and destroys them one by one.
+
+#include "harness.h"
+
+#include "relocating_vector.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+constexpr size_t kGrowthElements = size_t{1} << 20;
+constexpr size_t kEraseElements = 4096;
+
+template <typename T>
+void Push(RelocatingVector<T>& vector, T value) {
+    vector.PushBack(std::move(value));
+}
+
+template <typename T>
+void Push(std::vector<T>& vector, T value) {
+    vector.push_back(std::move(value));
+}
+
+template <typename T>
+size_t Size(const RelocatingVector<T>& vector) {
+    return vector.Size();
+}
+
+template <typename T>
+size_t Size(const std::vector<T>& vector) {
+    return vector.size();
+}
+
+template <typename T>
+void EraseFront(RelocatingVector<T>& vector) {
+    vector.Erase(vector.begin());
+}
+
+template <typename T>
+void EraseFront(std::vector<T>& vector) {
+    vector.erase(vector.begin());
+}
+
+// Elements are copies of one shared object, or empty unique pointers, so that the measurement is
+// about moving them rather than creating them.
+template <typename Ptr>
+struct Element {
+    static Ptr Prototype() {
+        return Ptr();
+    }
+    static Ptr Copy(const Ptr& prototype) {
+        return prototype;
+    }
+};
+
+template <>
+SharedPtr<Payload> Element<SharedPtr<Payload>>::Prototype() {
+    return MakeShared<Payload>();
+}
+
+template <>
+std::shared_ptr<Payload> Element<std::shared_ptr<Payload>>::Prototype() {
+    return std::make_shared<Payload>();
+}
+
+template <>
+UniquePtr<Payload> Element<UniquePtr<Payload>>::Copy(const UniquePtr<Payload>&) {
+    return UniquePtr<Payload>();
+}
+
+// One iteration appends one element to a vector that grows from empty to `kGrowthElements` and is
+// then destroyed, without reserving.
+template <template <typename...> class Vector, typename Ptr>
+void Growth(BenchState& state) {
+    Ptr prototype = Element<Ptr>::Prototype();
+    for (size_t done = 0; done < state.Iterations(); done += kGrowthElements) {
+        size_t count = std::min(kGrowthElements, state.Iterations() - done);
+        Vector<Ptr> vector;
+        for (size_t i = 0; i < count; ++i) {
+            Push(vector, Element<Ptr>::Copy(prototype));
+        }
+        DoNotOptimize(vector);
+    }
+}
+
+// One iteration erases the first element of a vector of at most `kEraseElements`, shifting the
+// rest. The vector is refilled with the timer paused.
+template <template <typename...> class Vector, typename Ptr>
+void EraseFront(BenchState& state) {
+    Ptr prototype = Element<Ptr>::Prototype();
+    Vector<Ptr> vector;
+    state.PauseTimer();
+    for (size_t done = 0; done < state.Iterations(); done += kEraseElements) {
+        size_t count = std::min(kEraseElements, state.Iterations() - done);
+        while (Size(vector) < kEraseElements) {
+            Push(vector, Element<Ptr>::Copy(prototype));
+        }
+        state.ResumeTimer();
+        for (size_t i = 0; i < count; ++i) {
+            EraseFront(vector);
+        }
+        state.PauseTimer();
+    }
+    state.ResumeTimer();
+}
+
+using Shared = SharedPtr<Payload>;
+using StdShared = std::shared_ptr<Payload>;
+using Unique = UniquePtr<Payload>;
+
+const RegisterBenchmarks kBenchmarks = {
+    {"vector_growth", "RelocatingVector<SharedPtr>", &Growth<RelocatingVector, Shared>},
+    {"vector_growth", "std::vector<SharedPtr>", &Growth<std::vector, Shared>},
+    {"vector_growth", "std::vector<std::shared_ptr>", &Growth<std::vector, StdShared>},
+    {"vector_growth", "RelocatingVector<UniquePtr>", &Growth<RelocatingVector, Unique>},
+    {"vector_growth", "std::vector<UniquePtr>", &Growth<std::vector, Unique>},
+
+    {"vector_erase_front", "RelocatingVector<SharedPtr>", &EraseFront<RelocatingVector, Shared>},
+    {"vector_erase_front", "std::vector<SharedPtr>", &EraseFront<std::vector, Shared>},
+    {"vector_erase_front", "std::vector<std::shared_ptr>", &EraseFront<std::vector, StdShared>},
+};
+
+}  // namespace
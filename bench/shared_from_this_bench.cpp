@@ -0,0 +1,106 @@
+// `SharedFromThis` (weak.h) in a callback-heavy event loop, against `std::enable_shared_from_this`
+// and against copying an owning pointer the caller already has.
+
+#include "harness.h"
+
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace {
+
+template <typename Counter>
+struct Session : EnableSharedFromThis<Session<Counter>, Counter> {
+    int64_t handled = 0;
+};
+
+struct StdSession : std::enable_shared_from_this<StdSession> {
+    int64_t handled = 0;
+};
+
+struct PlainSession {
+    int64_t handled = 0;
+};
+
+constexpr size_t kSessions = 64;
+
+// How a handler gets an owning pointer to its session to re-arm itself.
+template <typename Counter>
+struct FromThis {
+    using Ptr = SharedPtr<Session<Counter>, Counter>;
+
+    static Ptr Make() {
+        return MakeShared<Session<Counter>, Counter>();
+    }
+    static Ptr Self(const Ptr& current) {
+        return current->SharedFromThis();
+    }
+};
+
+struct StdFromThis {
+    using Ptr = std::shared_ptr<StdSession>;
+
+    static Ptr Make() {
+        return std::make_shared<StdSession>();
+    }
+    static Ptr Self(const Ptr& current) {
+        return current->shared_from_this();
+    }
+};
+
+template <typename Counter>
+struct Copy {
+    using Ptr = SharedPtr<PlainSession, Counter>;
+
+    static Ptr Make() {
+        return MakeShared<PlainSession, Counter>();
+    }
+    static Ptr Self(const Ptr& current) {
+        return current;
+    }
+};
+
+// One iteration runs one callback, which posts the next callback of its session.
+template <typename Family>
+void EventLoop(BenchState& state) {
+    using Ptr = typename Family::Ptr;
+    std::deque<Ptr> queue;
+    for (size_t i = 0; i < kSessions; ++i) {
+        queue.push_back(Family::Make());
+    }
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr current = std::move(queue.front());
+        queue.pop_front();
+        ++current->handled;
+        queue.push_back(Family::Self(current));
+    }
+    state.StopTimer();
+}
+
+// Creation and destruction, which includes wiring up the weak-this for `FromThis`.
+template <typename Family>
+void Make(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        typename Family::Ptr session = Family::Make();
+        DoNotOptimize(session);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"event_loop", "SharedFromThis", &EventLoop<FromThis<SimpleCounter>>},
+    {"event_loop", "SharedFromThis<AtomicCounter>", &EventLoop<FromThis<AtomicCounter>>},
+    {"event_loop", "std::enable_shared_from_this", &EventLoop<StdFromThis>},
+    {"event_loop", "SharedPtr copy", &EventLoop<Copy<SimpleCounter>>},
+    {"event_loop", "SharedPtr<AtomicCounter> copy", &EventLoop<Copy<AtomicCounter>>},
+
+    {"from_this_make", "EnableSharedFromThis", &Make<FromThis<SimpleCounter>>},
+    {"from_this_make", "std::enable_shared_from_this", &Make<StdFromThis>},
+    {"from_this_make", "plain", &Make<Copy<SimpleCounter>>},
+};
+
+}  // namespace
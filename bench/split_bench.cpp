@@ -0,0 +1,68 @@
+// `MakeShared` of large objects with the split layout (sw_fwd.h, `SplitPayload`) against the
+// in-place one, which keeps the whole object allocated while weak references are left.
+
+#include "harness.h"
+
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr size_t kPayloadSize = 4096;
+
+template <int Tag>
+struct Large {
+    int64_t value = 1;
+    char data[kPayloadSize - sizeof(int64_t)];
+};
+
+using SplitLarge = Large<0>;
+using InPlaceLarge = Large<1>;
+
+}  // namespace
+
+template <>
+struct SplitPayload<InPlaceLarge> : std::false_type {};
+
+static_assert(SplitPayload<SplitLarge>::value);
+
+namespace {
+
+constexpr size_t kWeakEntries = 1024;
+
+// Creation and destruction without weak references, where splitting only costs the extra
+// allocation.
+template <typename T>
+void MakeDestroy(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<T> ptr = MakeShared<T>();
+        DoNotOptimize(ptr);
+    }
+}
+
+// A cache of `kWeakEntries` weak references to short-lived objects: one iteration makes an
+// object, overwrites the oldest entry with a weak reference to it and drops the strong one.
+// In-place blocks keep every object's memory until its entry is overwritten.
+template <typename T>
+void WeakCache(BenchState& state) {
+    std::vector<WeakPtr<T>> entries(kWeakEntries);
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<T> ptr = MakeShared<T>();
+        entries[i % kWeakEntries] = WeakPtr<T>(ptr);
+    }
+    state.StopTimer();
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"large_make_destroy", "split", &MakeDestroy<SplitLarge>},
+    {"large_make_destroy", "in place", &MakeDestroy<InPlaceLarge>},
+
+    {"large_weak_cache", "split", &WeakCache<SplitLarge>},
+    {"large_weak_cache", "in place", &WeakCache<InPlaceLarge>},
+};
+
+}  // namespace
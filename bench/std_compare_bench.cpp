@@ -0,0 +1,239 @@
+// Micro-benchmarks of the basic operations against `std::shared_ptr` / `std::unique_ptr`.
+
+#include "harness.h"
+
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+struct IntrusivePayload : SimpleRefCounted<IntrusivePayload> {
+    int64_t value = 1;
+};
+
+struct AtomicIntrusivePayload : ThreadSafeRefCounted<AtomicIntrusivePayload> {
+    int64_t value = 1;
+};
+
+// How each subject makes a pointer the preferred way.
+template <typename Ptr>
+struct Subject;
+
+template <typename Counter>
+struct Subject<SharedPtr<Payload, Counter>> {
+    static SharedPtr<Payload, Counter> Make() {
+        return MakeShared<Payload, Counter>();
+    }
+};
+
+template <>
+struct Subject<std::shared_ptr<Payload>> {
+    static std::shared_ptr<Payload> Make() {
+        return std::make_shared<Payload>();
+    }
+};
+
+template <>
+struct Subject<UniquePtr<Payload>> {
+    static UniquePtr<Payload> Make() {
+        return MakeUnique<Payload>();
+    }
+};
+
+template <>
+struct Subject<std::unique_ptr<Payload>> {
+    static std::unique_ptr<Payload> Make() {
+        return std::make_unique<Payload>();
+    }
+};
+
+template <typename T>
+struct Subject<IntrusivePtr<T>> {
+    static IntrusivePtr<T> Make() {
+        return MakeIntrusive<T>();
+    }
+};
+
+using Shared = SharedPtr<Payload>;
+using AtomicShared = SharedPtr<Payload, AtomicCounter>;
+using StdShared = std::shared_ptr<Payload>;
+using Unique = UniquePtr<Payload>;
+using StdUnique = std::unique_ptr<Payload>;
+using Intrusive = IntrusivePtr<IntrusivePayload>;
+using AtomicIntrusive = IntrusivePtr<AtomicIntrusivePayload>;
+
+// Copy construction and destruction of the copy.
+template <typename Ptr>
+void Copy(BenchState& state) {
+    Ptr ptr = Subject<Ptr>::Make();
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr copy(ptr);
+        DoNotOptimize(copy);
+    }
+}
+
+// Move assignment back and forth between two pointers.
+template <typename Ptr>
+void Move(BenchState& state) {
+    Ptr first = Subject<Ptr>::Make();
+    Ptr second;
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr& from = (i % 2 == 0 ? first : second);
+        Ptr& to = (i % 2 == 0 ? second : first);
+        to = std::move(from);
+        DoNotOptimize(to);
+    }
+}
+
+// Destruction of the last reference, object and block included.
+template <typename Ptr>
+void Destroy(BenchState& state) {
+    std::vector<Ptr> ptrs;
+    ptrs.reserve(state.Iterations());
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        ptrs.push_back(Subject<Ptr>::Make());
+    }
+    state.ResetTimer();
+    ptrs.clear();
+    state.StopTimer();
+}
+
+// Creation and destruction.
+template <typename Ptr>
+void Make(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr ptr = Subject<Ptr>::Make();
+        DoNotOptimize(ptr);
+    }
+}
+
+// Creation from `new` (separate control block) and destruction.
+template <typename Ptr>
+void FromNew(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr ptr(new Payload());
+        DoNotOptimize(ptr);
+    }
+}
+
+// Promotion of a weak reference to a live object.
+template <typename Ptr, typename Weak>
+void WeakLock(BenchState& state) {
+    Ptr ptr = Subject<Ptr>::Make();
+    Weak weak(ptr);
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        Ptr locked = weak.lock();
+        DoNotOptimize(locked);
+    }
+}
+
+template <typename Counter>
+void WeakLockShared(BenchState& state) {
+    SharedPtr<Payload, Counter> ptr = MakeShared<Payload, Counter>();
+    WeakPtr<Payload, Counter> weak(ptr);
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        SharedPtr<Payload, Counter> locked = weak.Lock();
+        DoNotOptimize(locked);
+    }
+}
+
+constexpr size_t kArraySize = 4096;
+
+// One read-modify-write of an element through `operator[]`.
+template <typename Array>
+void Index(BenchState& state) {
+    Array array(new int64_t[kArraySize]());
+    state.ResetTimer();
+    int64_t sum = 0;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        size_t index = i % kArraySize;
+        sum += array[index];
+        array[index] = sum;
+    }
+    DoNotOptimize(sum);
+}
+
+void IndexRaw(BenchState& state) {
+    std::vector<int64_t> storage(kArraySize);
+    int64_t* array = storage.data();
+    DoNotOptimize(array);
+    state.ResetTimer();
+    int64_t sum = 0;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        size_t index = i % kArraySize;
+        sum += array[index];
+        array[index] = sum;
+    }
+    DoNotOptimize(sum);
+}
+
+// Every thread copies the same pointer, so all of them hit one counter.
+template <typename Ptr>
+void CopyContended(BenchState& state) {
+    Ptr ptr = Subject<Ptr>::Make();
+    RunOnThreads(state, [&](size_t) {
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            Ptr copy(ptr);
+            DoNotOptimize(copy);
+        }
+    });
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"copy", "SharedPtr", &Copy<Shared>},
+    {"copy", "SharedPtr<AtomicCounter>", &Copy<AtomicShared>},
+    {"copy", "std::shared_ptr", &Copy<StdShared>},
+    {"copy", "IntrusivePtr", &Copy<Intrusive>},
+    {"copy", "IntrusivePtr<ThreadSafeRefCounted>", &Copy<AtomicIntrusive>},
+
+    {"move", "SharedPtr", &Move<Shared>},
+    {"move", "std::shared_ptr", &Move<StdShared>},
+    {"move", "UniquePtr", &Move<Unique>},
+    {"move", "std::unique_ptr", &Move<StdUnique>},
+    {"move", "IntrusivePtr", &Move<Intrusive>},
+
+    {"destroy", "SharedPtr", &Destroy<Shared>},
+    {"destroy", "SharedPtr<AtomicCounter>", &Destroy<AtomicShared>},
+    {"destroy", "std::shared_ptr", &Destroy<StdShared>},
+    {"destroy", "UniquePtr", &Destroy<Unique>},
+    {"destroy", "std::unique_ptr", &Destroy<StdUnique>},
+    {"destroy", "IntrusivePtr", &Destroy<Intrusive>},
+
+    {"make", "MakeShared", &Make<Shared>},
+    {"make", "SharedPtr(new T)", &FromNew<Shared>},
+    {"make", "std::make_shared", &Make<StdShared>},
+    {"make", "std::shared_ptr(new T)", &FromNew<StdShared>},
+    {"make", "MakeUnique", &Make<Unique>},
+    {"make", "std::make_unique", &Make<StdUnique>},
+    {"make", "MakeIntrusive", &Make<Intrusive>},
+
+    {"weak_lock", "WeakPtr", &WeakLockShared<SimpleCounter>},
+    {"weak_lock", "WeakPtr<AtomicCounter>", &WeakLockShared<AtomicCounter>},
+    {"weak_lock", "std::weak_ptr", &WeakLock<StdShared, std::weak_ptr<Payload>>},
+
+    {"array_index", "UniquePtr<T[]>", &Index<UniquePtr<int64_t[]>>},
+    {"array_index", "std::unique_ptr<T[]>", &Index<std::unique_ptr<int64_t[]>>},
+    {"array_index", "T*", &IndexRaw},
+
+    {"copy_contended", "SharedPtr<AtomicCounter>", &CopyContended<AtomicShared>, true},
+    {"copy_contended", "std::shared_ptr", &CopyContended<StdShared>, true},
+    {"copy_contended", "IntrusivePtr<ThreadSafeRefCounted>", &CopyContended<AtomicIntrusive>,
+     true},
+};
+
+}  // namespace
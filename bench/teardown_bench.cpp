@@ -0,0 +1,75 @@
+// Last-reference teardown through the control block's dispatch table (sw_fwd.h) against the
+// static path `SharedPtr` takes for `final` types.
+
+#include "harness.h"
+
+#include "shared.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+int64_t destroyed = 0;
+
+// Non-trivial destructor, so there is something for the static path to inline.
+struct Leaf {
+    ~Leaf() {
+        destroyed += value;
+    }
+
+    int64_t value = 1;
+};
+
+struct FinalLeaf final {
+    ~FinalLeaf() {
+        destroyed += value;
+    }
+
+    int64_t value = 1;
+};
+
+// One table pointer and the two counts in front of the object, nothing else.
+static_assert(sizeof(MakeSharedBlock<Leaf, SimpleCounter>) <=
+              sizeof(void*) + 2 * sizeof(size_t) + sizeof(Leaf));
+static_assert(sizeof(MakeSharedBlock<FinalLeaf, SimpleCounter>) ==
+              sizeof(MakeSharedBlock<Leaf, SimpleCounter>));
+
+// Destruction of the last reference of `MakeShared` objects, object and block included.
+template <typename T, typename Counter>
+void Teardown(BenchState& state) {
+    std::vector<SharedPtr<T, Counter>> ptrs;
+    ptrs.reserve(state.Iterations());
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        ptrs.push_back(MakeShared<T, Counter>());
+    }
+    state.ResetTimer();
+    ptrs.clear();
+    state.StopTimer();
+    DoNotOptimize(destroyed);
+}
+
+template <typename T>
+void StdTeardown(BenchState& state) {
+    std::vector<std::shared_ptr<T>> ptrs;
+    ptrs.reserve(state.Iterations());
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        ptrs.push_back(std::make_shared<T>());
+    }
+    state.ResetTimer();
+    ptrs.clear();
+    state.StopTimer();
+    DoNotOptimize(destroyed);
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"teardown", "SharedPtr<T>", &Teardown<Leaf, SimpleCounter>},
+    {"teardown", "SharedPtr<T final>", &Teardown<FinalLeaf, SimpleCounter>},
+    {"teardown", "SharedPtr<T, AtomicCounter>", &Teardown<Leaf, AtomicCounter>},
+    {"teardown", "SharedPtr<T final, AtomicCounter>", &Teardown<FinalLeaf, AtomicCounter>},
+    {"teardown", "std::shared_ptr<T>", &StdTeardown<Leaf>},
+    {"teardown", "std::shared_ptr<T final>", &StdTeardown<FinalLeaf>},
+};
+
+}  // namespace
@@ -0,0 +1,96 @@
+// Pointer-dense containers of `ThinSharedPtr` (thin.h) against `SharedPtr`, which is twice as
+// wide.
+
+#include "harness.h"
+
+#include "shared.h"
+#include "thin.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    int64_t value = 1;
+};
+
+static_assert(sizeof(ThinSharedPtr<Payload>) == sizeof(void*));
+static_assert(sizeof(SharedPtr<Payload>) == 2 * sizeof(void*));
+
+constexpr size_t kElements = size_t{1} << 20;
+
+template <typename Ptr>
+struct Subject;
+
+template <>
+struct Subject<SharedPtr<Payload>> {
+    static SharedPtr<Payload> Make() {
+        return MakeShared<Payload>();
+    }
+};
+
+template <>
+struct Subject<ThinSharedPtr<Payload>> {
+    static ThinSharedPtr<Payload> Make() {
+        return MakeThinShared<Payload>();
+    }
+};
+
+template <>
+struct Subject<std::shared_ptr<Payload>> {
+    static std::shared_ptr<Payload> Make() {
+        return std::make_shared<Payload>();
+    }
+};
+
+template <typename Ptr>
+std::vector<Ptr> MakeElements() {
+    std::vector<Ptr> elements;
+    elements.reserve(kElements);
+    for (size_t i = 0; i < kElements; ++i) {
+        elements.push_back(Subject<Ptr>::Make());
+    }
+    return elements;
+}
+
+// One iteration follows one pointer of a vector of `kElements`, in order.
+template <typename Ptr>
+void Scan(BenchState& state) {
+    std::vector<Ptr> elements = MakeElements<Ptr>();
+    state.ResetTimer();
+    int64_t sum = 0;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        sum += elements[i % kElements]->value;
+    }
+    DoNotOptimize(sum);
+    state.StopTimer();
+}
+
+// One iteration copies one element of a vector of `kElements` into a new vector and destroys the
+// copy.
+template <typename Ptr>
+void CopyVector(BenchState& state) {
+    std::vector<Ptr> elements = MakeElements<Ptr>();
+    state.ResetTimer();
+    for (size_t done = 0; done < state.Iterations(); done += kElements) {
+        size_t count = std::min(kElements, state.Iterations() - done);
+        std::vector<Ptr> copy(elements.begin(), elements.begin() + count);
+        DoNotOptimize(copy.data());
+    }
+    state.StopTimer();
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"dense_scan", "ThinSharedPtr", &Scan<ThinSharedPtr<Payload>>},
+    {"dense_scan", "SharedPtr", &Scan<SharedPtr<Payload>>},
+    {"dense_scan", "std::shared_ptr", &Scan<std::shared_ptr<Payload>>},
+
+    {"dense_copy", "ThinSharedPtr", &CopyVector<ThinSharedPtr<Payload>>},
+    {"dense_copy", "SharedPtr", &CopyVector<SharedPtr<Payload>>},
+    {"dense_copy", "std::shared_ptr", &CopyVector<std::shared_ptr<Payload>>},
+};
+
+}  // namespace
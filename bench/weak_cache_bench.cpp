@@ -0,0 +1,118 @@
+// Interning through `WeakValueCache` (weak_cache.h) against a map of strong references behind one
+// mutex, which is what it replaces.
+
+#include "harness.h"
+
+#include "shared.h"
+#include "weak_cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::atomic<int64_t> live_values = 0;
+
+// Stands in for a parsed schema or a compiled regex.
+struct Interned {
+    explicit Interned(uint64_t key) : key(key) {
+        live_values.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Interned() {
+        live_values.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    uint64_t key;
+    char data[248] = {};
+};
+
+using Shared = SharedPtr<Interned, AtomicCounter>;
+
+class WeakCache {
+public:
+    Shared GetOrCreate(uint64_t key) {
+        return cache_.GetOrCreate(key, key);
+    }
+
+    size_t Size() const {
+        return cache_.Size();
+    }
+
+private:
+    WeakValueCache<uint64_t, Interned> cache_;
+};
+
+// Never forgets a value once it is made.
+class StrongCache {
+public:
+    Shared GetOrCreate(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Shared& value = entries_[key];
+        if (!value) {
+            value = MakeShared<Interned, AtomicCounter>(key);
+        }
+        return value;
+    }
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Shared> entries_;
+};
+
+constexpr uint64_t kHotKeys = 4096;
+constexpr uint64_t kChurnKeys = uint64_t{1} << 16;
+constexpr size_t kUsers = 256;
+
+// Every thread looks up random keys out of `kHotKeys` that all stay in use, so every lookup hits.
+template <typename Cache>
+void Hit(BenchState& state) {
+    Cache cache;
+    std::vector<Shared> users;
+    for (uint64_t key = 0; key < kHotKeys; ++key) {
+        users.push_back(cache.GetOrCreate(key));
+    }
+    RunOnThreads(state, [&](size_t thread) {
+        XorShift random(thread + 1);
+        for (size_t i = 0; i < state.Iterations(); ++i) {
+            Shared value = cache.GetOrCreate(random.Next() % kHotKeys);
+            DoNotOptimize(value);
+        }
+    });
+}
+
+// Keys come from a large space and only the last `kUsers` values are in use at any time. The
+// counters report what each cache holds at the end.
+template <typename Cache>
+void Churn(BenchState& state) {
+    int64_t live_before = live_values.load(std::memory_order_relaxed);
+    Cache cache;
+    std::vector<Shared> users(kUsers);
+    XorShift random;
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        users[i % kUsers] = cache.GetOrCreate(random.Next() % kChurnKeys);
+    }
+    state.StopTimer();
+    int64_t live = live_values.load(std::memory_order_relaxed) - live_before;
+    state.SetCounter("entries", static_cast<double>(cache.Size()));
+    state.SetCounter("live_values", static_cast<double>(live));
+    state.SetCounter("value_bytes", static_cast<double>(live * sizeof(Interned)));
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"interning_hit", "WeakValueCache", &Hit<WeakCache>, true},
+    {"interning_hit", "strong map", &Hit<StrongCache>, true},
+
+    {"interning_churn", "WeakValueCache", &Churn<WeakCache>},
+    {"interning_churn", "strong map", &Churn<StrongCache>},
+};
+
+}  // namespace
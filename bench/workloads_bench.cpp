@@ -0,0 +1,196 @@
+// Macro workloads: whole data structures built on each kind of pointer.
+
+#include "harness.h"
+
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Base class of objects whose pointers need none.
+struct NoBase {};
+
+// Each family is a kind of owning pointer: `Ptr<T>`, the preferred way to `Make` one, and the
+// base class `T` needs for it.
+
+template <typename Counter>
+struct SharedFamily {
+    template <typename T>
+    using Ptr = SharedPtr<T, Counter>;
+    template <typename T>
+    using Base = NoBase;
+
+    template <typename T>
+    static Ptr<T> Make() {
+        return MakeShared<T, Counter>();
+    }
+};
+
+struct StdSharedFamily {
+    template <typename T>
+    using Ptr = std::shared_ptr<T>;
+    template <typename T>
+    using Base = NoBase;
+
+    template <typename T>
+    static Ptr<T> Make() {
+        return std::make_shared<T>();
+    }
+};
+
+struct UniqueFamily {
+    template <typename T>
+    using Ptr = UniquePtr<T>;
+    template <typename T>
+    using Base = NoBase;
+
+    template <typename T>
+    static Ptr<T> Make() {
+        return MakeUnique<T>();
+    }
+};
+
+struct StdUniqueFamily {
+    template <typename T>
+    using Ptr = std::unique_ptr<T>;
+    template <typename T>
+    using Base = NoBase;
+
+    template <typename T>
+    static Ptr<T> Make() {
+        return std::make_unique<T>();
+    }
+};
+
+struct IntrusiveFamily {
+    template <typename T>
+    using Ptr = IntrusivePtr<T>;
+    template <typename T>
+    using Base = SimpleRefCounted<T>;
+
+    template <typename T>
+    static Ptr<T> Make() {
+        return MakeIntrusive<T>();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tree build and teardown
+
+constexpr int kTreeDepth = 12;
+
+template <typename Family>
+struct TreeNode : Family::template Base<TreeNode<Family>> {
+    typename Family::template Ptr<TreeNode> left;
+    typename Family::template Ptr<TreeNode> right;
+    int64_t value = 1;
+};
+
+template <typename Family>
+typename Family::template Ptr<TreeNode<Family>> BuildTree(int depth) {
+    auto node = Family::template Make<TreeNode<Family>>();
+    if (depth > 1) {
+        node->left = BuildTree<Family>(depth - 1);
+        node->right = BuildTree<Family>(depth - 1);
+    }
+    return node;
+}
+
+// Pointee of any of the pointers; `UniquePtr` has no const `operator*`.
+template <typename Ptr>
+auto* Raw(const Ptr& ptr) {
+    return ptr.operator->();
+}
+
+template <typename Node>
+int64_t SumTree(const Node* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+    return node->value + SumTree(Raw(node->left)) + SumTree(Raw(node->right));
+}
+
+// One iteration builds a complete binary tree of 2^kTreeDepth - 1 nodes, walks it and tears it
+// down.
+template <typename Family>
+void Tree(BenchState& state) {
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        auto root = BuildTree<Family>(kTreeDepth);
+        DoNotOptimize(SumTree(Raw(root)));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LRU cache churn
+
+constexpr size_t kLruCapacity = 1024;
+constexpr uint64_t kLruKeys = 2048;
+
+template <typename Family>
+struct LruValue : Family::template Base<LruValue<Family>> {
+    int64_t payload[8] = {};
+};
+
+// Values are handed out as shared references that may outlive their entry.
+template <typename Family>
+class LruCache {
+public:
+    using Ptr = typename Family::template Ptr<LruValue<Family>>;
+
+    Ptr Get(uint64_t key) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+        if (entries_.size() == kLruCapacity) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, Family::template Make<LruValue<Family>>());
+        index_.emplace(key, entries_.begin());
+        return entries_.front().second;
+    }
+
+private:
+    std::list<std::pair<uint64_t, Ptr>> entries_;
+    std::unordered_map<uint64_t, typename std::list<std::pair<uint64_t, Ptr>>::iterator> index_;
+};
+
+// One iteration is one lookup of a random key; about half of them miss and evict an entry.
+template <typename Family>
+void Lru(BenchState& state) {
+    LruCache<Family> cache;
+    XorShift random;
+    for (size_t i = 0; i < kLruCapacity; ++i) {
+        cache.Get(random.Next() % kLruKeys);
+    }
+    state.ResetTimer();
+    for (size_t i = 0; i < state.Iterations(); ++i) {
+        auto value = cache.Get(random.Next() % kLruKeys);
+        DoNotOptimize(value);
+    }
+}
+
+const RegisterBenchmarks kBenchmarks = {
+    {"tree", "SharedPtr", &Tree<SharedFamily<SimpleCounter>>},
+    {"tree", "SharedPtr<AtomicCounter>", &Tree<SharedFamily<AtomicCounter>>},
+    {"tree", "std::shared_ptr", &Tree<StdSharedFamily>},
+    {"tree", "UniquePtr", &Tree<UniqueFamily>},
+    {"tree", "std::unique_ptr", &Tree<StdUniqueFamily>},
+    {"tree", "IntrusivePtr", &Tree<IntrusiveFamily>},
+
+    {"lru", "SharedPtr", &Lru<SharedFamily<SimpleCounter>>},
+    {"lru", "SharedPtr<AtomicCounter>", &Lru<SharedFamily<AtomicCounter>>},
+    {"lru", "std::shared_ptr", &Lru<StdSharedFamily>},
+    {"lru", "IntrusivePtr", &Lru<IntrusiveFamily>},
+};
+
+}  // namespace
@@ -0,0 +1,298 @@
+#pragma once
+
+#include "sw_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Biased reference counting (Choi, Shull, Torrellas, PACT'18) for `SharedPtr<T, BiasedCounter>`.
+//
+// The thread that creates the block (`MakeShared`, `SharedPtr(Y*)`, `Reset(Y*)`) owns it and
+// counts its references in a plain, never-RMW'ed field. Every other thread uses an atomic
+// counter which may go negative when a reference made by the owner is dropped elsewhere. The two
+// halves are merged when the owner lets go (its half drops to zero). If another thread drives the
+// atomic half negative it hands the block over to the owner, which merges it on its next
+// allocation, on `DrainBiasedQueue()` or when it exits.
+//
+// Long-lived owner threads that mostly hand objects out should call `DrainBiasedQueue()` now and
+// then (e.g. once per event loop iteration); otherwise handed-over blocks wait for the next
+// allocation of the owner.
+
+class BiasedCounter;
+
+template <>
+struct WeakCounterFor<BiasedCounter> {
+    using Type = AtomicCounter;
+};
+
+class BiasedThreadRecord {
+public:
+    // Record of the calling thread, created on first use.
+    static BiasedThreadRecord* Acquire() {
+        if (current_ == nullptr) {
+            static thread_local ExitGuard guard;
+            current_ = new BiasedThreadRecord();
+        }
+        return current_;
+    }
+
+    // Record of the calling thread, or `nullptr` if it never owned a block.
+    static BiasedThreadRecord* Current() {
+        return current_;
+    }
+
+    void IncRef() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void DecRef() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    bool HasQueued() const {
+        return (queue_.load(std::memory_order_relaxed) & ~kClosed) != 0;
+    }
+
+    // Hand `counter` over to the owner. Fails once the owner has exited.
+    bool Push(BiasedCounter* counter);
+
+    // Merge everything handed over so far. Only called by the owner.
+    void Drain();
+
+private:
+    struct ExitGuard {
+        ~ExitGuard() {
+            if (current_ != nullptr) {
+                current_->Close();
+                current_ = nullptr;
+            }
+        }
+    };
+
+    static constexpr uintptr_t kClosed = 1;
+
+    void Close();
+    void MergeList(uintptr_t head);
+
+    static inline thread_local BiasedThreadRecord* current_ = nullptr;
+
+    // The thread itself plus every block still biased towards it.
+    std::atomic<size_t> refs_ = 1;
+    // Treiber stack of handed over counters, `kClosed` is set once the thread exits.
+    std::atomic<uintptr_t> queue_ = 0;
+};
+
+class BiasedCounter {
+public:
+    explicit BiasedCounter(size_t count) : biased_(count) {
+        BiasedThreadRecord* record = BiasedThreadRecord::Acquire();
+        if (record->HasQueued()) {
+            record->Drain();
+        }
+        record->IncRef();
+        owner_.store(record, std::memory_order_relaxed);
+    }
+
+    size_t IncRef() {
+        if (IsOwner()) {
+            size_t count = biased_.load(std::memory_order_relaxed) + 1;
+            biased_.store(count, std::memory_order_relaxed);
+            return count;
+        }
+        shared_.fetch_add(kOne, std::memory_order_relaxed);
+        return RefCount();
+    }
+
+    // Returns zero exactly when the caller has to finish the release.
+    size_t DecRef() {
+        if (IsOwner()) {
+            size_t count = biased_.load(std::memory_order_relaxed) - 1;
+            biased_.store(count, std::memory_order_relaxed);
+            if (count != 0) {
+                return count;
+            }
+            return MergeOnRelease();
+        }
+
+        // Taken before the decrement: the owner may merge and let go of its record right after
+        // it. If the decrement queues the block, the block still holds its reference to the
+        // record (see `MergeOnRelease`), so the record is alive for `HandOver`. If we see no
+        // owner, its half is already zero, so the decrement cannot go negative and queue.
+        BiasedThreadRecord* owner = owner_.load(std::memory_order_acquire);
+        intptr_t value = shared_.load(std::memory_order_relaxed);
+        intptr_t next;
+        do {
+            next = value - kOne;
+            if (!(next & kMerged) && Count(next) < 0) {
+                next |= kQueued;
+            }
+        } while (!shared_.compare_exchange_weak(value, next, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+        if (!(value & kQueued) && (next & kQueued)) {
+            // Drop the last reference we know of; the owner has the rest of the count.
+            HandOver(owner);
+            return 1;
+        }
+        if (next & kQueued) {
+            // Still on the owner's queue, the owner finishes the release when it merges.
+            return 1;
+        }
+        if (!(next & kMerged)) {
+            // Not merged yet, so the owner still holds a reference.
+            return 1;
+        }
+        return static_cast<size_t>(Count(next));
+    }
+
+    bool IncRefIfNotZero() {
+        if (IsOwner()) {
+            // Non-zero as long as the owner has not let go, unless other threads already dropped
+            // the owner's references and handed the block over.
+            size_t count = biased_.load(std::memory_order_relaxed);
+            intptr_t value = shared_.load(std::memory_order_acquire);
+            if ((value & kQueued) && static_cast<intptr_t>(count) + Count(value) <= 0) {
+                return false;
+            }
+            biased_.store(count + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        intptr_t value = shared_.load(std::memory_order_relaxed);
+        do {
+            intptr_t count = Count(value);
+            if (!(value & kMerged) && (value & kQueued)) {
+                count += static_cast<intptr_t>(biased_.load(std::memory_order_relaxed));
+            } else if (!(value & kMerged)) {
+                // The owner's half is non-zero until it merges, and merging changes `shared_`.
+                count = 1;
+            }
+            if (count <= 0) {
+                return false;
+            }
+        } while (!shared_.compare_exchange_weak(value, value + kOne, std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+
+    size_t RefCount() const {
+        intptr_t count = static_cast<intptr_t>(biased_.load(std::memory_order_relaxed)) +
+                         Count(shared_.load(std::memory_order_relaxed));
+        return count > 0 ? static_cast<size_t>(count) : 0;
+    }
+
+private:
+    friend class BiasedThreadRecord;
+    friend void AttachCounter(BiasedCounter& counter, ControlBlockBase<BiasedCounter>* block);
+
+    // Low bits of `shared_` are flags, the rest is a signed count.
+    static constexpr intptr_t kMerged = 1;
+    static constexpr intptr_t kQueued = 2;
+    static constexpr intptr_t kOne = 4;
+
+    static intptr_t Count(intptr_t value) {
+        return (value & ~(kMerged | kQueued)) / kOne;
+    }
+
+    bool IsOwner() const {
+        BiasedThreadRecord* current = BiasedThreadRecord::Current();
+        return current != nullptr && current == owner_.load(std::memory_order_relaxed);
+    }
+
+    // The owner's half dropped to zero: from now on everybody uses `shared_`.
+    size_t MergeOnRelease() {
+        BiasedThreadRecord* owner = owner_.load(std::memory_order_relaxed);
+        // Release pairs with the acquire load in `DecRef`.
+        owner_.store(nullptr, std::memory_order_release);
+        intptr_t value = shared_.fetch_or(kMerged, std::memory_order_acq_rel);
+        if (value & kQueued) {
+            // Another thread is handing the block over to `owner` and may not have pushed it
+            // yet. The record stays referenced until the queued block is merged.
+            return 1;
+        }
+        owner->DecRef();
+        return static_cast<size_t>(Count(value));
+    }
+
+    void HandOver(BiasedThreadRecord* owner) {
+        if (!owner->Push(this)) {
+            // The owner is gone, so its half is frozen and we can merge it ourselves.
+            MergeQueued(owner);
+        }
+    }
+
+    // Fold the owner's half into `shared_`, take the block off the queue of `owner` and drop the
+    // block's reference to the record, which it keeps while queued even if already merged.
+    void MergeQueued(BiasedThreadRecord* owner) {
+        intptr_t biased = static_cast<intptr_t>(biased_.load(std::memory_order_relaxed));
+        ControlBlockBase<BiasedCounter>* block = block_;
+        biased_.store(0, std::memory_order_relaxed);
+        owner_.store(nullptr, std::memory_order_release);
+
+        intptr_t value = shared_.load(std::memory_order_relaxed);
+        intptr_t next;
+        do {
+            next = (value & ~kQueued) | kMerged;
+            if (!(value & kMerged)) {
+                next += biased * kOne;
+            }
+        } while (!shared_.compare_exchange_weak(value, next, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+        owner->DecRef();
+        if (Count(next) == 0) {
+            block->ReleaseLastShared();
+        }
+    }
+
+    std::atomic<BiasedThreadRecord*> owner_ = nullptr;
+    // Written by the owner only, atomic so that `RefCount` may read it from anywhere.
+    std::atomic<size_t> biased_;
+    std::atomic<intptr_t> shared_ = 0;
+    BiasedCounter* next_queued_ = nullptr;
+    ControlBlockBase<BiasedCounter>* block_ = nullptr;
+};
+
+inline void AttachCounter(BiasedCounter& counter, ControlBlockBase<BiasedCounter>* block) {
+    counter.block_ = block;
+}
+
+inline bool BiasedThreadRecord::Push(BiasedCounter* counter) {
+    // Acquire pairs with `Close`: once the queue is closed the caller merges the block itself and
+    // must see the exited owner's last `biased_`.
+    uintptr_t head = queue_.load(std::memory_order_acquire);
+    do {
+        if (head & kClosed) {
+            return false;
+        }
+        counter->next_queued_ = reinterpret_cast<BiasedCounter*>(head);
+    } while (!queue_.compare_exchange_weak(head, reinterpret_cast<uintptr_t>(counter),
+                                           std::memory_order_release, std::memory_order_acquire));
+    return true;
+}
+
+inline void BiasedThreadRecord::Drain() {
+    MergeList(queue_.exchange(0, std::memory_order_acquire));
+}
+
+inline void BiasedThreadRecord::Close() {
+    MergeList(queue_.exchange(kClosed, std::memory_order_acq_rel));
+    DecRef();
+}
+
+inline void BiasedThreadRecord::MergeList(uintptr_t head) {
+    BiasedCounter* counter = reinterpret_cast<BiasedCounter*>(head);
+    while (counter != nullptr) {
+        BiasedCounter* next = counter->next_queued_;
+        counter->MergeQueued(this);
+        counter = next;
+    }
+}
+
+// Merge the blocks other threads handed over to the calling thread.
+inline void DrainBiasedQueue() {
+    if (BiasedThreadRecord* record = BiasedThreadRecord::Current()) {
+        record->Drain();
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+// Thread-caching pool for small, equally sized allocations such as control blocks.
+//
+// Requests up to `kMaxSize` bytes are rounded up to a multiple of `kGranularity` and served from
+// per-thread free lists, one per size class. The lists are refilled from `kSlabSize` slabs that
+// are aligned to their size, so the slab header (and the cache that owns it) is found by masking
+// the block address. A block freed by another thread is pushed onto the owner's lock-free remote
+// list for that class; the owner takes the whole batch back with one exchange once its local list
+// runs dry. Caches of exited threads are adopted by the next thread that starts allocating, so
+// their slabs and pending remote frees are reused rather than leaked. Slabs are never returned
+// to the system.
+class BlockPool {
+public:
+    static constexpr size_t kGranularity = 16;
+    static constexpr size_t kMaxSize = 256;
+    static constexpr size_t kSlabSize = size_t{64} << 10;
+
+    static void* Allocate(size_t size, size_t alignment) {
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(size, std::align_val_t(alignment));
+        }
+        if (size > kMaxSize || alignment > kGranularity) {
+            return ::operator new(size);
+        }
+        SizeClass& size_class = Acquire()->classes[ClassOf(size)];
+        if (size_class.local == nullptr &&
+            size_class.remote.load(std::memory_order_relaxed) != nullptr) {
+            size_class.local = size_class.remote.exchange(nullptr, std::memory_order_acquire);
+        }
+        if (FreeBlock* block = size_class.local) {
+            size_class.local = block->next;
+            return block;
+        }
+        return Carve(size_class, ClassOf(size));
+    }
+
+    static void Deallocate(void* ptr, size_t size, size_t alignment) {
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(ptr, std::align_val_t(alignment));
+            return;
+        }
+        if (size > kMaxSize || alignment > kGranularity) {
+            ::operator delete(ptr);
+            return;
+        }
+        Cache* owner = SlabOf(ptr)->owner;
+        SizeClass& size_class = owner->classes[ClassOf(size)];
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        if (owner == current_) {
+            block->next = size_class.local;
+            size_class.local = block;
+            return;
+        }
+        block->next = size_class.remote.load(std::memory_order_relaxed);
+        while (!size_class.remote.compare_exchange_weak(
+            block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    static constexpr size_t kClasses = kMaxSize / kGranularity;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct SizeClass {
+        FreeBlock* local = nullptr;
+        std::atomic<FreeBlock*> remote = nullptr;
+        char* bump = nullptr;
+        char* bump_end = nullptr;
+    };
+
+    struct Cache {
+        SizeClass classes[kClasses];
+        Cache* next_orphan = nullptr;
+    };
+
+    struct alignas(kGranularity) Slab {
+        Cache* owner;
+    };
+
+    struct ExitGuard {
+        ~ExitGuard() {
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            current_->next_orphan = orphans_;
+            orphans_ = current_;
+            current_ = nullptr;
+        }
+    };
+
+    static size_t ClassOf(size_t size) {
+        return (size == 0 ? 0 : (size - 1) / kGranularity);
+    }
+
+    static Slab* SlabOf(void* ptr) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~(kSlabSize - 1));
+    }
+
+    static Cache* Acquire() {
+        if (current_ == nullptr) {
+            static thread_local ExitGuard guard;
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            if (orphans_ != nullptr) {
+                current_ = orphans_;
+                orphans_ = orphans_->next_orphan;
+            } else {
+                current_ = new Cache();
+            }
+        }
+        return current_;
+    }
+
+    static void* Carve(SizeClass& size_class, size_t index) {
+        size_t block_size = (index + 1) * kGranularity;
+        if (size_class.bump + block_size > size_class.bump_end) {
+            Slab* slab = static_cast<Slab*>(::operator new(kSlabSize, std::align_val_t(kSlabSize)));
+            slab->owner = current_;
+            size_class.bump = reinterpret_cast<char*>(slab + 1);
+            size_class.bump_end = reinterpret_cast<char*>(slab) + kSlabSize;
+        }
+        void* block = size_class.bump;
+        size_class.bump += block_size;
+        return block;
+    }
+
+    static inline thread_local Cache* current_ = nullptr;
+    static inline std::mutex orphans_mutex_;
+    static inline Cache* orphans_ = nullptr;
+};
+
+// Allocator over `BlockPool`. Stateless, so it adds no bytes to the blocks that store it.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(BlockPool::Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        BlockPool::Deallocate(ptr, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const {
+        return false;
+    }
+};
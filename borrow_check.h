@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+// Build with -DSMART_POINTERS_CHECK_BORROWS to verify that no object is destroyed while a
+// `Borrowed` (borrowed.h) still refers to it. Every borrow is registered under its owner (the
+// control block of a `SharedPtr`, the object of an `IntrusivePtr` or `UniquePtr`), owners report
+// right before they destroy the object, and a live borrow then aborts the program. The registry
+// takes a global mutex, so this is for debug builds only. Without the macro the hooks are empty
+// and a `Borrowed` holds nothing but the object pointer.
+#ifdef SMART_POINTERS_CHECK_BORROWS
+inline constexpr bool kCheckBorrows = true;
+#else
+inline constexpr bool kCheckBorrows = false;
+#endif
+
+class BorrowCheck {
+public:
+    static void Borrow(const void* owner) {
+        if constexpr (kCheckBorrows) {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            ++registry.borrows[owner];
+        }
+    }
+
+    static void Return(const void* owner) {
+        if constexpr (kCheckBorrows) {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.borrows.find(owner);
+            if (--it->second == 0) {
+                registry.borrows.erase(it);
+            }
+        }
+    }
+
+    // Called right before the object identified by `owner` is destroyed.
+    static void Released(const void* owner) {
+        if constexpr (kCheckBorrows) {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.borrows.find(owner);
+            if (it != registry.borrows.end()) {
+                std::fprintf(stderr, "Object owned by %p destroyed while borrowed %zu time(s)\n",
+                             owner, it->second);
+                std::abort();
+            }
+        }
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<const void*, size_t> borrows;
+    };
+
+    // Created on first use, so builds without the check have no registry at all.
+    static Registry& GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+};
+
+// Registers a borrow of `owner` for as long as it lives. Empty unless borrows are checked, so
+// that `Borrowed` stays trivially copyable.
+template <bool kEnabled = kCheckBorrows>
+class BorrowMark {
+public:
+    BorrowMark() = default;
+
+    explicit BorrowMark(const void*) {
+    }
+};
+
+template <>
+class BorrowMark<true> {
+public:
+    BorrowMark() : owner_(nullptr) {
+    }
+
+    explicit BorrowMark(const void* owner) : owner_(owner) {
+        Mark();
+    }
+
+    BorrowMark(const BorrowMark& other) : owner_(other.owner_) {
+        Mark();
+    }
+
+    BorrowMark& operator=(const BorrowMark& other) {
+        if (owner_ != other.owner_) {
+            Unmark();
+            owner_ = other.owner_;
+            Mark();
+        }
+        return *this;
+    }
+
+    ~BorrowMark() {
+        Unmark();
+    }
+
+private:
+    void Mark() {
+        if (owner_ != nullptr) {
+            BorrowCheck::Borrow(owner_);
+        }
+    }
+
+    void Unmark() {
+        if (owner_ != nullptr) {
+            BorrowCheck::Return(owner_);
+        }
+    }
+
+    const void* owner_;
+};
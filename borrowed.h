@@ -0,0 +1,166 @@
+#pragma once
+
+#include "borrow_check.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <type_traits>
+#include <utility>  // std::exchange
+
+// Non-owning view of an object kept alive by someone else's `SharedPtr`, `IntrusivePtr` or
+// `UniquePtr`, for parameters of hot call paths:
+//
+//     void Render(Borrowed<Scene> scene);
+//
+//     SharedPtr<Scene> scene = ...;
+//     Render(scene);  // no count changes, one pointer dereference to reach the object
+//
+// A borrow is just the object pointer, so it is passed in a register. Making, copying and
+// dropping one never touches a count. A callee that needs to keep the object beyond the call asks
+// for ownership explicitly with `Promote<IntrusivePtr<Scene>>()`, which adds a reference to an
+// intrusively counted object, or `Promote<SharedPtr<Scene, Counter>>()`, which goes through the
+// object's `EnableSharedFromThis<..., Counter>` base (weak.h). Borrows of temporaries do not
+// compile; the caller must keep the owner alive for as long as the borrow lives, which
+// `SMART_POINTERS_CHECK_BORROWS` (borrow_check.h) verifies.
+template <typename T>
+class Borrowed : private BorrowMark<> {
+public:
+    static_assert(!std::is_array_v<T>, "Arrays cannot be borrowed");
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    Borrowed() : ptr_(nullptr) {
+    }
+
+    Borrowed(std::nullptr_t) : Borrowed() {
+    }
+
+    template <typename U, typename Counter,
+              std::enable_if_t<std::is_convertible_v<U*, T*>, bool> = true>
+    Borrowed(const SharedPtr<U, Counter>& shared) : Borrowed(shared.Get(), shared.control_block_) {
+    }
+
+    template <typename U, std::enable_if_t<std::is_convertible_v<U*, T*>, bool> = true>
+    Borrowed(const IntrusivePtr<U>& intrusive) : Borrowed(intrusive.Get(), intrusive.Get()) {
+    }
+
+    template <typename U, typename Deleter,
+              std::enable_if_t<std::is_convertible_v<U*, T*>, bool> = true>
+    Borrowed(const UniquePtr<U, Deleter>& unique) : Borrowed(unique.Get(), unique.Get()) {
+    }
+
+    template <typename U, typename Counter>
+    Borrowed(const SharedPtr<U, Counter>&&) = delete;
+
+    template <typename U>
+    Borrowed(const IntrusivePtr<U>&&) = delete;
+
+    template <typename U, typename Deleter>
+    Borrowed(const UniquePtr<U, Deleter>&&) = delete;
+
+    template <typename U, std::enable_if_t<std::is_convertible_v<U*, T*>, bool> = true>
+    Borrowed(const Borrowed<U>& other)
+        : BorrowMark<>(static_cast<const BorrowMark<>&>(other)), ptr_(other.ptr_) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Ownership
+
+    // A new owning pointer to the object. `IntrusivePtr<U>` needs an intrusively counted object
+    // and throws `BadPromote` if no `IntrusivePtr` owns it. `SharedPtr<U, Counter>` needs an
+    // `EnableSharedFromThis<V, Counter>` base and throws `BadWeakPtr` if no `SharedPtr` owns the
+    // object; the result shares the object's own control block, not that of an aliasing owner
+    // the borrow may have been made from. An empty borrow promotes to an empty pointer.
+    template <typename Ptr>
+    Ptr Promote() const {
+        Ptr owner;
+        if (ptr_ != nullptr) {
+            PromoteInto(owner);
+        }
+        return owner;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+
+    T& operator*() const {
+        return *ptr_;
+    }
+
+    T* operator->() const {
+        return ptr_;
+    }
+
+    explicit operator bool() const {
+        return (ptr_ != nullptr);
+    }
+
+private:
+    template <typename U>
+    friend class Borrowed;
+
+    // `owner` (control block of a `SharedPtr`, object of the other pointers) is only kept by the
+    // borrow check.
+    Borrowed(T* ptr, const void* owner)
+        : BorrowMark<>(ptr != nullptr ? owner : nullptr), ptr_(ptr) {
+    }
+
+    template <typename U, typename Counter>
+    void PromoteInto(SharedPtr<U, Counter>& owner) const {
+        PromoteInto(owner, SharedFromThisBase<Counter>(ptr_));
+    }
+
+    template <typename U, typename Counter, typename V>
+    void PromoteInto(SharedPtr<U, Counter>& owner,
+                     const EnableSharedFromThis<V, Counter>* base) const {
+        // Throws `BadWeakPtr` unless a `SharedPtr` owns the object. Its reference moves over.
+        SharedPtr<V, Counter> self(base->weak_this_);
+        owner.ptr_ = ptr_;
+        owner.control_block_ = std::exchange(self.control_block_, nullptr);
+        self.ptr_ = nullptr;
+    }
+
+    template <typename U, typename Counter>
+    void PromoteInto(SharedPtr<U, Counter>&, std::nullptr_t) const {
+        static_assert(sizeof(U) == 0,
+                      "Promote to SharedPtr<U, Counter> needs an EnableSharedFromThis<V, Counter> "
+                      "base");
+    }
+
+    template <typename U>
+    void PromoteInto(IntrusivePtr<U>& owner) const {
+        // A count of zero means no `IntrusivePtr` owns the object, e.g. a `UniquePtr` does.
+        if (!ptr_->TryIncRef()) {
+            throw BadPromote();
+        }
+        owner.ptr_ = ptr_;
+    }
+
+    // The `EnableSharedFromThis` base of the object for `Counter`, or null if it has none.
+    template <typename Counter, typename V>
+    static const EnableSharedFromThis<V, Counter>* SharedFromThisBase(
+        const EnableSharedFromThis<V, Counter>* base) {
+        return base;
+    }
+
+    template <typename Counter>
+    static std::nullptr_t SharedFromThisBase(const volatile void*) {
+        return nullptr;
+    }
+
+    T* ptr_;
+};
+
+// Without the borrow check a borrow is passed like a raw pointer.
+static_assert(kCheckBorrows || sizeof(Borrowed<int>) == sizeof(int*));
+
+template <typename T>
+struct IsTriviallyRelocatable<Borrowed<T>> : std::bool_constant<!kCheckBorrows> {};
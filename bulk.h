@@ -0,0 +1,218 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+// Copy, fill and reset ranges of `SharedPtr`s or `IntrusivePtr`s with one count update per
+// control block (or object) instead of one per element:
+//
+//     std::vector<SharedPtr<Node>> copy(nodes.size());
+//     BulkCopy(nodes.begin(), nodes.end(), copy.begin());
+//     ...
+//     BulkReset(copy.begin(), copy.end());
+//
+// Pending updates are coalesced in a small direct-mapped table, so ranges pointing at a few hot
+// objects cost a handful of counter operations however long they are; with many distinct objects
+// this degrades to one operation per element, as for an element-wise copy. No reference is dropped
+// while an increment of its target is still pending, so the ranges may overlap as they may for
+// `std::copy`.
+
+// Raw access to a pointer type for `RefBatch`. `Target` is what carries the count.
+template <typename Ptr>
+struct BulkRefs;
+
+template <typename T, typename Counter>
+struct BulkRefs<SharedPtr<T, Counter>> {
+    using Ptr = SharedPtr<T, Counter>;
+    using Target = ControlBlockBase<Counter>;
+
+    static Target* TargetOf(const Ptr& ptr) {
+        return ptr.control_block_;
+    }
+
+    // Make `to` a copy of `from` without touching any count.
+    static void Assign(Ptr& to, const Ptr& from) {
+        to.ptr_ = from.ptr_;
+        to.control_block_ = from.control_block_;
+    }
+
+    static void Clear(Ptr& ptr) {
+        ptr.ptr_ = nullptr;
+        ptr.control_block_ = nullptr;
+    }
+
+    static void Add(Target* block, size_t n) {
+        TraceRef<typename Ptr::ElementType>(RefOp::kInc);
+        block->AddSharedRefs(n);
+    }
+
+    static void Sub(Target* block, size_t n) {
+        TraceRef<typename Ptr::ElementType>(RefOp::kDec);
+        block->DecSharedRefs(n);
+    }
+};
+
+template <typename T>
+struct BulkRefs<IntrusivePtr<T>> {
+    using Ptr = IntrusivePtr<T>;
+    using Target = T;
+
+    static Target* TargetOf(const Ptr& ptr) {
+        return ptr.ptr_;
+    }
+
+    static void Assign(Ptr& to, const Ptr& from) {
+        to.ptr_ = from.ptr_;
+    }
+
+    static void Clear(Ptr& ptr) {
+        ptr.ptr_ = nullptr;
+    }
+
+    static void Add(Target* object, size_t n) {
+        object->IncRef(n);
+    }
+
+    static void Sub(Target* object, size_t n) {
+        object->DecRef(n);
+    }
+};
+
+// References to add and to drop, counted per target. A target whose slot is taken by another one
+// is updated right away, so ranges of distinct targets cost one count update per element and
+// little more. Before any batched drop is applied, all pending additions are; a drop applied
+// right away first cancels against a pending addition to the same target.
+template <typename Ptr>
+class RefBatch {
+public:
+    using Target = typename BulkRefs<Ptr>::Target;
+
+    RefBatch() = default;
+
+    RefBatch(const RefBatch&) = delete;
+    RefBatch& operator=(const RefBatch&) = delete;
+
+    ~RefBatch() {
+        Flush();
+    }
+
+    void Acquire(Target* target) {
+        if (target == nullptr) {
+            return;
+        }
+        Slot& slot = acquired_[Index(target)];
+        if (slot.target != target) {
+            if (slot.count != 0) {
+                BulkRefs<Ptr>::Add(target, 1);
+                return;
+            }
+            slot.target = target;
+        }
+        ++slot.count;
+    }
+
+    void Release(Target* target) {
+        if (target == nullptr) {
+            return;
+        }
+        Slot& slot = released_[Index(target)];
+        if (slot.target != target) {
+            if (slot.count != 0) {
+                ReleaseNow(target);
+                return;
+            }
+            slot.target = target;
+        }
+        ++slot.count;
+    }
+
+    void Flush() {
+        for (Slot& slot : acquired_) {
+            if (slot.count != 0) {
+                BulkRefs<Ptr>::Add(slot.target, slot.count);
+                slot.count = 0;
+            }
+        }
+        for (Slot& slot : released_) {
+            if (slot.count != 0) {
+                Slot taken = slot;
+                slot.count = 0;
+                BulkRefs<Ptr>::Sub(taken.target, taken.count);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kSlots = 64;
+
+    struct Slot {
+        Target* target = nullptr;
+        size_t count = 0;
+    };
+
+    static size_t Index(const Target* target) {
+        uintptr_t bits = reinterpret_cast<uintptr_t>(target);
+        return ((bits >> 4) ^ (bits >> 12)) % kSlots;
+    }
+
+    // The reference may be the one a pending addition was copied from, so take that addition
+    // back instead of dropping what may be the last counted reference.
+    void ReleaseNow(Target* target) {
+        Slot& acquired = acquired_[Index(target)];
+        if (acquired.target == target && acquired.count != 0) {
+            --acquired.count;
+        } else {
+            BulkRefs<Ptr>::Sub(target, 1);
+        }
+    }
+
+    Slot acquired_[kSlots] = {};
+    Slot released_[kSlots] = {};
+};
+
+// `std::copy` for ranges of smart pointers.
+template <typename InputIt, typename OutputIt>
+OutputIt BulkCopy(InputIt first, InputIt last, OutputIt d_first) {
+    using Ptr = typename std::iterator_traits<InputIt>::value_type;
+    RefBatch<Ptr> batch;
+    for (; first != last; ++first, ++d_first) {
+        const Ptr& from = *first;
+        Ptr& to = *d_first;
+        batch.Acquire(BulkRefs<Ptr>::TargetOf(from));
+        batch.Release(BulkRefs<Ptr>::TargetOf(to));
+        BulkRefs<Ptr>::Assign(to, from);
+    }
+    batch.Flush();
+    return d_first;
+}
+
+// `std::fill` for ranges of smart pointers.
+template <typename ForwardIt, typename Ptr>
+void BulkFill(ForwardIt first, ForwardIt last, const Ptr& value) {
+    // `value` may be in the range
+    const Ptr held = value;
+    RefBatch<Ptr> batch;
+    for (; first != last; ++first) {
+        batch.Acquire(BulkRefs<Ptr>::TargetOf(held));
+        batch.Release(BulkRefs<Ptr>::TargetOf(*first));
+        BulkRefs<Ptr>::Assign(*first, held);
+    }
+    batch.Flush();
+}
+
+// `Reset()` every pointer in the range, e.g. right before destroying it.
+template <typename ForwardIt>
+void BulkReset(ForwardIt first, ForwardIt last) {
+    using Ptr = typename std::iterator_traits<ForwardIt>::value_type;
+    RefBatch<Ptr> batch;
+    for (; first != last; ++first) {
+        batch.Release(BulkRefs<Ptr>::TargetOf(*first));
+        BulkRefs<Ptr>::Clear(*first);
+    }
+    batch.Flush();
+}
@@ -107,6 +107,9 @@ class CompressedPair : ProxyFirst<F>, ProxySecond<S> {
 public:
     CompressedPair() = default;
 
+    explicit CompressedPair(const F& first) : ProxyFirst<F>(first), ProxySecond<S>() {
+    }
+
     CompressedPair(F&& first, S&& second)
         : ProxyFirst<F>(std::move(first)), ProxySecond<S>(std::move(second)) {
     }
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <type_traits>
+#include <utility>  // std::declval
+
+// Reference counters shared by `RefCounted` (intrusive.h) and the `SharedPtr`/`WeakPtr` control
+// blocks (sw_fwd.h). Every counter exposes the same interface:
+//   IncRef()          - add a reference, returns the new value;
+//   DecRef()          - drop a reference, returns the new value;
+//   DecRefToZero()    - drop a reference, true if the count was already zero or has just reached
+//                       it, i.e. nobody else references the object any more;
+//   IncRefIfNotZero() - add a reference unless the count already reached zero;
+//   RefCount()        - current value.
+// and optionally, for the bulk helpers in bulk.h:
+//   Add(n), Sub(n)    - add or drop `n` references at once, returns the new value.
+
+// Single-threaded counter. Compiles down to plain arithmetic on a `size_t`.
+class SimpleCounter {
+public:
+    SimpleCounter() = default;
+
+    explicit SimpleCounter(size_t count) : count_(count) {
+    }
+
+    size_t IncRef() {
+        ++count_;
+        return count_;
+    }
+    size_t DecRef() {
+        --count_;
+        return count_;
+    }
+    bool DecRefToZero() {
+        if (count_ == 0) {
+            return true;
+        }
+        --count_;
+        return count_ == 0;
+    }
+    bool IncRefIfNotZero() {
+        if (count_ == 0) {
+            return false;
+        }
+        ++count_;
+        return true;
+    }
+    size_t RefCount() const {
+        return count_;
+    }
+    size_t Add(size_t n) {
+        count_ += n;
+        return count_;
+    }
+    size_t Sub(size_t n) {
+        count_ -= n;
+        return count_;
+    }
+
+private:
+    size_t count_ = 0;
+};
+
+// Thread-safe counter with the weakest orderings that are still correct.
+// New references are always made from an existing one, so increments publish nothing and are
+// relaxed. Decrements are acq_rel: each one releases the writes made through the dropped
+// reference, and the one that reaches zero acquires all of them before the object is destroyed.
+class AtomicCounter {
+public:
+    AtomicCounter() = default;
+
+    explicit AtomicCounter(size_t count) : count_(count) {
+    }
+
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    size_t DecRef() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    // A single `fetch_sub`: a counter that was already zero wraps around, but the object is being
+    // destroyed anyway.
+    bool DecRefToZero() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) <= 1;
+    }
+    // CAS loop, so a counter that dropped to zero is never brought back to life.
+    bool IncRefIfNotZero() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!count_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                               std::memory_order_relaxed));
+        return true;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+    size_t Add(size_t n) {
+        return count_.fetch_add(n, std::memory_order_relaxed) + n;
+    }
+    size_t Sub(size_t n) {
+        return count_.fetch_sub(n, std::memory_order_acq_rel) - n;
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
+template <typename Counter, typename = void>
+struct HasBulkRefs : std::false_type {};
+
+template <typename Counter>
+struct HasBulkRefs<Counter, std::void_t<decltype(std::declval<Counter&>().Add(size_t{}))>>
+    : std::true_type {};
+
+// `counter.Add(n)` / `counter.Sub(n)`, or `n` single steps for counters without them.
+template <typename Counter>
+size_t AddRefs(Counter& counter, size_t n) {
+    if constexpr (HasBulkRefs<Counter>::value) {
+        return counter.Add(n);
+    } else {
+        size_t count = counter.RefCount();
+        for (size_t i = 0; i < n; ++i) {
+            count = counter.IncRef();
+        }
+        return count;
+    }
+}
+
+template <typename Counter>
+size_t SubRefs(Counter& counter, size_t n) {
+    if constexpr (HasBulkRefs<Counter>::value) {
+        return counter.Sub(n);
+    } else {
+        size_t count = counter.RefCount();
+        for (size_t i = 0; i < n; ++i) {
+            count = counter.DecRef();
+        }
+        return count;
+    }
+}
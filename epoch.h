@@ -0,0 +1,221 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation for `RefCounted` objects.
+//
+// Readers pin the current epoch with an `EpochGuard` and follow plain pointers (`IntrusivePtr::Get`
+// or raw links) without touching reference counts. An object whose count drops to zero is not
+// destroyed right away: the `EpochRetire` deleter hands it to `EpochDomain`, which destroys it
+// once every thread that could still see it has left its critical section. The global epoch only
+// moves from `e` to `e + 1` after all pinned threads have observed `e`, so an object retired in
+// epoch `e` is unreachable to everybody by the time the epoch reaches `e + 2`.
+//
+// The domain keeps objects alive, it does not make links atomic: readers may only follow links
+// that writers publish with atomic stores (e.g. `std::atomic<T*>` next to the owning
+// `IntrusivePtr`). Objects still pending when the program exits are not destroyed.
+class EpochDomain {
+public:
+    using DestroyFn = void (*)(void*);
+
+    static constexpr size_t kCollectThreshold = 64;
+
+    static void Enter() {
+        Record* record = Acquire();
+        if (record->nesting++ == 0) {
+            uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+            record->state.store(epoch << 1 | kActive, std::memory_order_relaxed);
+            // Pairs with the fence in `TryAdvance`: either the advancing thread sees us pinned or
+            // we see everything that was unlinked before it advanced.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void Leave() {
+        Record* record = current_;
+        if (--record->nesting == 0) {
+            record->state.store(0, std::memory_order_release);
+        }
+    }
+
+    // Destroy `object` with `destroy` after a grace period. Call once `object` is unreachable.
+    static void Retire(void* object, DestroyFn destroy) {
+        Record* record = Acquire();
+        record->retired.push_back({object, destroy, epoch_.load(std::memory_order_acquire)});
+        if (record->retired.size() >= kCollectThreshold && record->nesting == 0) {
+            TryAdvance();
+            Collect();
+        }
+    }
+
+    // Destroy whatever the calling thread (and exited threads) retired that is past its grace
+    // period.
+    static void Collect() {
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        std::vector<Retired> ready;
+        if (Record* record = current_) {
+            TakeReady(record->retired, epoch, ready);
+        }
+        {
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            TakeReady(orphans_, epoch, ready);
+        }
+        // Destructors may retire more objects, so nothing is iterated while they run.
+        for (Retired& retired : ready) {
+            retired.destroy(retired.object);
+        }
+    }
+
+    // Destroy everything the calling thread and exited threads have retired so far. Blocks until
+    // the threads that are pinned now have left; must not be called inside an `EpochGuard`.
+    static void Synchronize() {
+        for (;;) {
+            TryAdvance();
+            Collect();
+            Record* record = current_;
+            bool local_empty = (record == nullptr || record->retired.empty());
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            if (local_empty && orphans_.empty()) {
+                return;
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t kActive = 1;
+
+    struct Retired {
+        void* object;
+        DestroyFn destroy;
+        uint64_t epoch;
+    };
+
+    // One per thread, reused by later threads once its thread exits. Never freed.
+    struct Record {
+        // `epoch << 1 | kActive` while pinned, zero otherwise.
+        std::atomic<uint64_t> state = 0;
+        std::atomic<bool> in_use = true;
+        size_t nesting = 0;
+        std::vector<Retired> retired;
+        Record* next = nullptr;
+    };
+
+    struct ExitGuard {
+        ~ExitGuard() {
+            {
+                std::lock_guard<std::mutex> lock(orphans_mutex_);
+                for (Retired& retired : current_->retired) {
+                    orphans_.push_back(retired);
+                }
+            }
+            current_->retired.clear();
+            current_->in_use.store(false, std::memory_order_release);
+            current_ = nullptr;
+        }
+    };
+
+    static Record* Acquire() {
+        if (current_ == nullptr) {
+            static thread_local ExitGuard guard;
+            current_ = Adopt();
+        }
+        return current_;
+    }
+
+    static Record* Adopt() {
+        for (Record* record = records_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            bool in_use = false;
+            if (record->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire,
+                                                       std::memory_order_relaxed)) {
+                return record;
+            }
+        }
+        Record* record = new Record();
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        return record;
+    }
+
+    // Move to the next epoch if every pinned thread has observed the current one.
+    static void TryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        for (Record* record = records_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            uint64_t state = record->state.load(std::memory_order_acquire);
+            if ((state & kActive) && (state >> 1) != epoch) {
+                return;
+            }
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed);
+    }
+
+    static void TakeReady(std::vector<Retired>& retired, uint64_t epoch,
+                          std::vector<Retired>& ready) {
+        size_t kept = 0;
+        for (const Retired& entry : retired) {
+            if (entry.epoch + 2 <= epoch) {
+                ready.push_back(entry);
+            } else {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    static inline std::atomic<uint64_t> epoch_ = 1;
+    static inline std::atomic<Record*> records_ = nullptr;
+    static inline thread_local Record* current_ = nullptr;
+    static inline std::mutex orphans_mutex_;
+    static inline std::vector<Retired> orphans_;
+};
+
+// Pins the current epoch for its lifetime. Nests.
+class EpochGuard {
+public:
+    EpochGuard() {
+        EpochDomain::Enter();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() {
+        EpochDomain::Leave();
+    }
+};
+
+// `RefCounted` deleter that retires the object into `EpochDomain`; `Inner` destroys it after the
+// grace period.
+//
+//     class Node : public ThreadSafeRefCounted<Node, EpochRetire<>> { ... };
+template <typename Inner = DefaultDelete>
+struct EpochRetire {
+    template <typename T>
+    static void Destroy(T* object) {
+        EpochDomain::Retire(object, [](void* ptr) { Inner::Destroy(static_cast<T*>(ptr)); });
+    }
+};
+
+// Owning pointer to an object found inside an `EpochGuard`, or null if its last reference is
+// already gone and it only waits for reclamation.
+template <typename T>
+IntrusivePtr<T> TryPromote(T* ptr) {
+    if (ptr == nullptr || !ptr->TryIncRef()) {
+        return nullptr;
+    }
+    IntrusivePtr<T> result(ptr);
+    ptr->DecRef();
+    return result;
+}
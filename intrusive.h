@@ -1,29 +1,17 @@
 #pragma once
 
+#include "borrow_check.h"
+#include "counter.h"
+#include "relocatable.h"
+#include "trace.h"
+
 #include <cstddef>  // for std::nullptr_t
 #include <utility>  // for std::exchange / std::swap
 
-class SimpleCounter {
-public:
-    size_t IncRef() {
-        ++count_;
-        return count_;
-    }
-    size_t DecRef() {
-        --count_;
-        return count_;
-    }
-    size_t RefCount() const {
-        return count_;
-    }
-
-private:
-    size_t count_ = 0;
-};
-
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
+        TraceRef<T>(RefOp::kFree);
         delete object;
     }
 };
@@ -33,22 +21,44 @@ class RefCounted {
 public:
     // Increase reference counter.
     void IncRef() {
+        TraceRef<Derived>(RefOp::kInc);
         counter_.IncRef();
     }
 
     // Decrease reference counter.
-    // Destroy object using Deleter when the last instance dies.
+    // Destroy object using Deleter when the last instance dies (or if there was none).
     void DecRef() {
-        if (RefCount() == 0) {
+        TraceRef<Derived>(RefOp::kDec);
+        if (counter_.DecRefToZero()) {
+            BorrowCheck::Released(static_cast<Derived*>(this));
             Deleter().Destroy(static_cast<Derived*>(this));
-            return;
         }
-        counter_.DecRef();
-        if (RefCount() == 0) {
+    }
+
+    // Change the reference counter by `n` at once, see bulk.h. A bulk update is traced as one
+    // operation.
+    void IncRef(size_t n) {
+        TraceRef<Derived>(RefOp::kInc);
+        AddRefs(counter_, n);
+    }
+    void DecRef(size_t n) {
+        TraceRef<Derived>(RefOp::kDec);
+        if (SubRefs(counter_, n) == 0) {
+            BorrowCheck::Released(static_cast<Derived*>(this));
             Deleter().Destroy(static_cast<Derived*>(this));
         }
     }
 
+    // Increase reference counter unless it has already dropped to zero, i.e. the object is
+    // waiting for its `Deleter` (see epoch.h).
+    bool TryIncRef() {
+        if (!counter_.IncRefIfNotZero()) {
+            return false;
+        }
+        TraceRef<Derived>(RefOp::kInc);
+        return true;
+    }
+
     // Get current counter value (the number of strong references).
     size_t RefCount() const {
         return counter_.RefCount();
@@ -61,6 +71,9 @@ private:
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using ThreadSafeRefCounted = RefCounted<Derived, AtomicCounter, D>;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
@@ -87,7 +100,7 @@ public:
         }
     }
 
-    IntrusivePtr(IntrusivePtr&& other) {
+    IntrusivePtr(IntrusivePtr&& other) noexcept {
         ptr_ = other.ptr_;
         other.ptr_ = nullptr;
     }
@@ -101,7 +114,7 @@ public:
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) {
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept {
         ptr_ = other.ptr_;
         other.ptr_ = nullptr;
     }
@@ -120,17 +133,14 @@ public:
         return *this;
     }
 
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
 
         Reset();
         ptr_ = other.ptr_;
-        if (ptr_) {
-            ptr_->IncRef();
-        }
-        other.Reset();
+        other.ptr_ = nullptr;
         return *this;
     }
 
@@ -179,12 +189,25 @@ public:
     }
 
 private:
+    template <typename Ptr>
+    friend struct BulkRefs;
+
+    template <typename Tp>
+    friend class IntrusiveWeakPtr;
+
+    template <typename Tp>
+    friend class Borrowed;
+
     T* ptr_;
 };
 
+template <typename T>
+struct IsTriviallyRelocatable<IntrusivePtr<T>> : std::true_type {};
+
 template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     T* ptr = new T(std::forward<Args>(args)...);
+    TraceRef<T>(RefOp::kAlloc);
     IntrusivePtr<T> iptr(ptr);
     return iptr;
 }
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Counts in front of a `WeakRefCounted` object. They outlive the object itself, so weak
+// references can still look at them after the destructor has run.
+template <typename Counter>
+struct WeakRefCounts {
+    WeakRefCounts() : strong(0), weak(1) {
+    }
+
+    Counter strong;
+    // Weak references, plus one held by all the strong ones together.
+    Counter weak;
+};
+
+// `RefCounted` that can also be referenced weakly, through `IntrusiveWeakPtr`:
+//
+//     class Node : public ThreadSafeWeakRefCounted<Node> { ... };
+//
+//     IntrusivePtr<Node> node = MakeIntrusive<Node>();
+//     IntrusiveWeakPtr<Node> weak(node);
+//     if (IntrusivePtr<Node> locked = weak.Lock()) { ... }
+//
+// Still one allocation per object: the class-specific `operator new` puts the counts right in
+// front of the object. The destructor runs when the last `IntrusivePtr` goes away, the memory is
+// freed when the last `IntrusiveWeakPtr` does. Objects must therefore be created with `new` (or
+// `MakeIntrusive`) as `Derived` or as a class that has `Derived` at offset zero, never on the
+// stack or as members.
+template <typename Derived, typename Counter>
+class WeakRefCounted {
+public:
+    using Counts = WeakRefCounts<Counter>;
+
+    // Increase reference counter.
+    void IncRef() {
+        TraceRef<Derived>(RefOp::kInc);
+        CountsOf(this)->strong.IncRef();
+    }
+
+    // Decrease reference counter. The last one destroys the object, its memory stays until
+    // there are no weak references either.
+    void DecRef() {
+        TraceRef<Derived>(RefOp::kDec);
+        Counts* counts = CountsOf(this);
+        if (counts->strong.DecRef() == 0) {
+            BorrowCheck::Released(static_cast<Derived*>(this));
+            static_cast<Derived*>(this)->~Derived();
+            DecWeakRef(counts);
+        }
+    }
+
+    // `n` references at once, see bulk.h.
+    void IncRef(size_t n) {
+        TraceRef<Derived>(RefOp::kInc);
+        AddRefs(CountsOf(this)->strong, n);
+    }
+
+    void DecRef(size_t n) {
+        TraceRef<Derived>(RefOp::kDec);
+        Counts* counts = CountsOf(this);
+        if (SubRefs(counts->strong, n) == 0) {
+            BorrowCheck::Released(static_cast<Derived*>(this));
+            static_cast<Derived*>(this)->~Derived();
+            DecWeakRef(counts);
+        }
+    }
+
+    bool TryIncRef() {
+        return TryIncRef(CountsOf(this));
+    }
+
+    // Get current counter value (the number of strong references).
+    size_t RefCount() const {
+        return CountsOf(this)->strong.RefCount();
+    }
+
+    static void* operator new(size_t size) {
+        char* storage = static_cast<char*>(
+            Alignment() > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+                ? ::operator new(size + Offset(), std::align_val_t(Alignment()))
+                : ::operator new(size + Offset()));
+        char* object = storage + Offset();
+        new (object - sizeof(Counts)) Counts();
+        return object;
+    }
+
+    static void* operator new(size_t size, std::align_val_t) {
+        return operator new(size);
+    }
+
+    // Only reached when a constructor throws, or through an explicit `delete`.
+    static void operator delete(void* object) {
+        if (object != nullptr) {
+            FreeStorage(CountsAt(object));
+        }
+    }
+
+    static void operator delete(void* object, std::align_val_t) {
+        operator delete(object);
+    }
+
+    // Array elements would get no counts in front of them.
+    static void* operator new[](size_t) = delete;
+    static void* operator new[](size_t, std::align_val_t) = delete;
+    static void operator delete[](void*) = delete;
+    static void operator delete[](void*, std::align_val_t) = delete;
+
+protected:
+    WeakRefCounted() = default;
+
+    // Copies get their own counts.
+    WeakRefCounted(const WeakRefCounted&) {
+    }
+
+    WeakRefCounted& operator=(const WeakRefCounted&) {
+        return *this;
+    }
+
+    ~WeakRefCounted() = default;
+
+private:
+    template <typename Tp>
+    friend class IntrusiveWeakPtr;
+
+    static constexpr size_t Alignment() {
+        return std::max<size_t>(alignof(Derived), __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    }
+
+    // Distance from the start of the allocation to the object.
+    static constexpr size_t Offset() {
+        return (sizeof(Counts) + Alignment() - 1) / Alignment() * Alignment();
+    }
+
+    // `object` is where `operator new` put the object.
+    static Counts* CountsAt(const void* object) {
+        char* start = static_cast<char*>(const_cast<void*>(object));
+        return reinterpret_cast<Counts*>(start - sizeof(Counts));
+    }
+
+    static Counts* CountsOf(const WeakRefCounted* object) {
+        return CountsAt(static_cast<const Derived*>(object));
+    }
+
+    static bool TryIncRef(Counts* counts) {
+        if (!counts->strong.IncRefIfNotZero()) {
+            return false;
+        }
+        TraceRef<Derived>(RefOp::kInc);
+        return true;
+    }
+
+    static void IncWeakRef(Counts* counts) {
+        TraceRef<Derived>(RefOp::kWeakInc);
+        counts->weak.IncRef();
+    }
+
+    static void DecWeakRef(Counts* counts) {
+        TraceRef<Derived>(RefOp::kWeakDec);
+        if (counts->weak.DecRef() == 0) {
+            FreeStorage(counts);
+        }
+    }
+
+    static void FreeStorage(Counts* counts) {
+        TraceRef<Derived>(RefOp::kFree);
+        char* storage = reinterpret_cast<char*>(counts + 1) - Offset();
+        counts->~Counts();
+        if constexpr (Alignment() > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(storage, std::align_val_t(Alignment()));
+        } else {
+            ::operator delete(storage);
+        }
+    }
+};
+
+template <typename Derived>
+using SimpleWeakRefCounted = WeakRefCounted<Derived, SimpleCounter>;
+
+template <typename Derived>
+using ThreadSafeWeakRefCounted = WeakRefCounted<Derived, AtomicCounter>;
+
+// Weak counterpart of `IntrusivePtr` for `WeakRefCounted` objects. Keeps the object's memory and
+// counts, but not the object itself, alive.
+template <typename T>
+class IntrusiveWeakPtr {
+public:
+    using Counts = typename T::Counts;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    IntrusiveWeakPtr() : ptr_(nullptr), counts_(nullptr) {
+    }
+
+    IntrusiveWeakPtr(const IntrusivePtr<T>& strong)
+        : ptr_(strong.Get()), counts_(ptr_ != nullptr ? T::CountsOf(ptr_) : nullptr) {
+        IncrementWeakCount();
+    }
+
+    IntrusiveWeakPtr(const IntrusiveWeakPtr& other) : ptr_(other.ptr_), counts_(other.counts_) {
+        IncrementWeakCount();
+    }
+
+    IntrusiveWeakPtr(IntrusiveWeakPtr&& other) noexcept
+        : ptr_(std::exchange(other.ptr_, nullptr)), counts_(std::exchange(other.counts_, nullptr)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    IntrusiveWeakPtr& operator=(const IntrusiveWeakPtr& other) {
+        IntrusiveWeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    IntrusiveWeakPtr& operator=(IntrusiveWeakPtr&& other) noexcept {
+        IntrusiveWeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~IntrusiveWeakPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (counts_) {
+            T::DecWeakRef(counts_);
+        }
+        ptr_ = nullptr;
+        counts_ = nullptr;
+    }
+
+    void Swap(IntrusiveWeakPtr& other) {
+        std::swap(ptr_, other.ptr_);
+        std::swap(counts_, other.counts_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        return (counts_ != nullptr ? counts_->strong.RefCount() : 0);
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    // Never revives an object whose last strong reference is already gone.
+    IntrusivePtr<T> Lock() const {
+        IntrusivePtr<T> strong;
+        if (counts_ && T::TryIncRef(counts_)) {
+            strong.ptr_ = ptr_;
+        }
+        return strong;
+    }
+
+private:
+    void IncrementWeakCount() {
+        if (counts_) {
+            T::IncWeakRef(counts_);
+        }
+    }
+
+    T* ptr_;
+    Counts* counts_;
+};
+
+template <typename T>
+struct IsTriviallyRelocatable<IntrusiveWeakPtr<T>> : std::true_type {};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "unique.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Default reset hook of `ObjectPool`: released objects are reused as they are.
+struct NoReset {
+    template <typename T>
+    void operator()(T&) const {
+    }
+};
+
+template <typename T, typename Reset = NoReset>
+class ObjectPool;
+
+// Returns the object to its pool instead of deleting it.
+template <typename T, typename Reset = NoReset>
+struct PoolDeleter {
+    void operator()(T* ptr) {
+        ObjectPool<T, Reset>::Release(ptr);
+    }
+};
+
+// Recycling of expensive objects (parse buffers, connection state) through `UniquePtr`:
+//
+//     struct ClearBuffer {
+//         void operator()(Buffer& buffer) const { buffer.Clear(); }
+//     };
+//     using BufferPool = ObjectPool<Buffer, ClearBuffer>;
+//
+//     BufferPool::Ptr buffer = BufferPool::Acquire();  // recycled or default-constructed
+//     ...                                              // back to the pool when it goes away
+//
+// Released objects are not destroyed: `Reset` brings them back to a reusable state and they wait
+// in a per-thread cache of up to `kCacheSize` objects. A full cache moves half of its objects to
+// a list shared by all threads, and an empty one refills from it, so producer/consumer thread
+// pairs keep recycling. Objects beyond `kMaxOverflow` in the shared list are destroyed, and so is
+// everything the pool still holds at exit. The pool is one per `<T, Reset>` pair, so
+// `PoolDeleter` is empty and `Ptr` is as small as a raw pointer.
+template <typename T, typename Reset>
+class ObjectPool {
+public:
+    using Ptr = UniquePtr<T, PoolDeleter<T, Reset>>;
+
+    static constexpr size_t kCacheSize = 64;
+    static constexpr size_t kMaxOverflow = 1024;
+
+    static_assert(sizeof(Ptr) == sizeof(T*));
+
+    static Ptr Acquire() {
+        Cache& cache = cache_;
+        if (cache.objects.empty()) {
+            Refill(cache);
+        }
+        if (cache.objects.empty()) {
+            return Ptr(new T());
+        }
+        T* object = cache.objects.back();
+        cache.objects.pop_back();
+        return Ptr(object);
+    }
+
+    // Hand `object` back, normally through `PoolDeleter`.
+    static void Release(T* object) {
+        if (object == nullptr) {
+            return;
+        }
+        Reset()(*object);
+        Cache& cache = cache_;
+        if (cache.objects.size() == kCacheSize) {
+            Spill(cache, kCacheSize / 2);
+        }
+        cache.objects.push_back(object);
+    }
+
+    // Destroy the objects waiting in the shared list.
+    static void Trim() {
+        std::vector<T*> objects;
+        {
+            std::lock_guard<std::mutex> lock(overflow_.mutex);
+            objects.swap(overflow_.objects);
+        }
+        for (T* object : objects) {
+            delete object;
+        }
+    }
+
+private:
+    struct Cache {
+        Cache() {
+            objects.reserve(kCacheSize);
+        }
+
+        // An exiting thread leaves its objects to the others.
+        ~Cache() {
+            Spill(*this, objects.size());
+        }
+
+        std::vector<T*> objects;
+    };
+
+    struct Overflow {
+        ~Overflow() {
+            for (T* object : objects) {
+                delete object;
+            }
+        }
+
+        std::mutex mutex;
+        std::vector<T*> objects;
+    };
+
+    // Take up to half a cache from the shared list.
+    static void Refill(Cache& cache) {
+        std::lock_guard<std::mutex> lock(overflow_.mutex);
+        size_t count = std::min(kCacheSize / 2, overflow_.objects.size());
+        cache.objects.insert(cache.objects.end(), overflow_.objects.end() - count,
+                             overflow_.objects.end());
+        overflow_.objects.resize(overflow_.objects.size() - count);
+    }
+
+    // Move the last `count` cached objects to the shared list, destroying those that do not fit.
+    static void Spill(Cache& cache, size_t count) {
+        auto first = cache.objects.end() - count;
+        {
+            std::lock_guard<std::mutex> lock(overflow_.mutex);
+            size_t room = kMaxOverflow - std::min(kMaxOverflow, overflow_.objects.size());
+            size_t moved = std::min(room, count);
+            overflow_.objects.insert(overflow_.objects.end(), first, first + moved);
+            first += moved;
+        }
+        for (auto it = first; it != cache.objects.end(); ++it) {
+            delete *it;
+        }
+        cache.objects.resize(cache.objects.size() - count);
+    }
+
+    static inline Overflow overflow_;
+    static inline thread_local Cache cache_;
+};
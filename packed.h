@@ -0,0 +1,134 @@
+#pragma once
+
+#include "sw_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Control block layouts with smaller counts, selected through the `Counter` parameter:
+//
+//     SharedPtr<T, PackedCounter>          - thread-safe, both counts in one 64-bit word;
+//     SharedPtr<T, NoWeak<AtomicCounter>>  - no weak count at all, `WeakPtr` does not compile.
+//
+// Either block is two pointers wide instead of three.
+
+// Shared count in the low 32 bits, weak count in the high 32 bits of one atomic word. Promoting a
+// weak reference is a single CAS. The decrement of a strong reference also returns the weak count,
+// so dropping the only reference of either kind frees the block without a second RMW on the weak
+// count. Neither count may exceed 2^32 - 1.
+struct PackedCounter {};
+
+class PackedCounts {
+public:
+    static constexpr bool kHasWeak = true;
+
+    template <typename Block>
+    explicit PackedCounts(Block*) : word_(kOneShared | kOneWeak) {
+    }
+
+    void IncShared() {
+        word_.fetch_add(kOneShared, std::memory_order_relaxed);
+    }
+    bool TryIncShared() {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        do {
+            if ((word & kSharedMask) == 0) {
+                return false;
+            }
+        } while (!word_.compare_exchange_weak(word, word + kOneShared, std::memory_order_acquire,
+                                              std::memory_order_relaxed));
+        return true;
+    }
+    RefsLeft DecShared() {
+        uint64_t word = word_.fetch_sub(kOneShared, std::memory_order_acq_rel);
+        if ((word & kSharedMask) != kOneShared) {
+            return RefsLeft::kStrong;
+        }
+        // Only the weak reference the strong ones share: nobody can make a new reference.
+        return (word == (kOneShared | kOneWeak)) ? RefsLeft::kNone : RefsLeft::kWeak;
+    }
+    void AddShared(size_t n) {
+        word_.fetch_add(n * kOneShared, std::memory_order_relaxed);
+    }
+    void SubShared(size_t n) {
+        word_.fetch_sub(n * kOneShared, std::memory_order_acq_rel);
+    }
+
+    void IncWeak() {
+        word_.fetch_add(kOneWeak, std::memory_order_relaxed);
+    }
+    bool DecWeak() {
+        return (word_.fetch_sub(kOneWeak, std::memory_order_acq_rel) >> kWeakShift) == 1;
+    }
+
+    size_t SharedCount() const {
+        return static_cast<size_t>(word_.load(std::memory_order_relaxed) & kSharedMask);
+    }
+
+private:
+    static constexpr int kWeakShift = 32;
+    static constexpr uint64_t kOneShared = 1;
+    static constexpr uint64_t kOneWeak = uint64_t{1} << kWeakShift;
+    static constexpr uint64_t kSharedMask = kOneWeak - 1;
+
+    std::atomic<uint64_t> word_;
+};
+
+template <>
+struct BlockCountsFor<PackedCounter> {
+    using Type = PackedCounts;
+};
+
+// Only a shared count, kept with `Counter`. The last strong reference frees the block right
+// away. Not for `BiasedCounter`, which needs the weak count while it merges.
+template <typename Counter>
+struct NoWeak {};
+
+template <typename Counter>
+class NoWeakCounts {
+public:
+    static constexpr bool kHasWeak = false;
+
+    template <typename Block>
+    explicit NoWeakCounts(Block*) : shared_(1) {
+    }
+
+    void IncShared() {
+        shared_.IncRef();
+    }
+    bool TryIncShared() {
+        return shared_.IncRefIfNotZero();
+    }
+    RefsLeft DecShared() {
+        return (shared_.DecRef() == 0) ? RefsLeft::kNone : RefsLeft::kStrong;
+    }
+    void AddShared(size_t n) {
+        AddRefs(shared_, n);
+    }
+    void SubShared(size_t n) {
+        SubRefs(shared_, n);
+    }
+
+    // Not reached: `DecShared` reports the last strong reference as `RefsLeft::kNone`.
+    bool DecWeak() {
+        return true;
+    }
+
+    size_t SharedCount() const {
+        return shared_.RefCount();
+    }
+
+private:
+    Counter shared_;
+};
+
+template <typename Counter>
+struct BlockCountsFor<NoWeak<Counter>> {
+    using Type = NoWeakCounts<Counter>;
+};
+
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockBase<AtomicCounter>) == 24);
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockBase<PackedCounter>) == 16);
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockBase<NoWeak<AtomicCounter>>) == 16);
+static_assert(sizeof(void*) != 8 || sizeof(ControlBlockBase<NoWeak<SimpleCounter>>) == 16);
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "intrusive.h"  // DefaultDelete
+#include "unique.h"     // DefaultDeleter
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// Deferred destruction: the owner that drops the last reference only queues the object, and the
+// actual teardown runs later on whichever thread drains the queue, either a `ReclaimThread` or an
+// explicit `DrainReclaimQueue()` call.
+//
+// Pick the flavour matching the pointer:
+//
+//     UniquePtr<Graph, DeferredDeleter<Graph>> unique(new Graph);
+//     SharedPtr<Graph> shared(new Graph, DeferredDeleter<Graph>());
+//     class Node : public ThreadSafeRefCounted<Node, DeferredDelete<>> { ... };
+//
+// Objects that own further deferred pointers queue their children instead of destroying them, and
+// the drain keeps going until the queue is empty, so deep chains are torn down iteratively.
+class ReclaimQueue {
+public:
+    using DestroyFn = void (*)(void*);
+
+    static void Push(void* object, DestroyFn destroy) {
+        Node* node = new Node{object, destroy, nullptr};
+        // Once published, the node may be drained and freed at any time, so it is not read again.
+        Node* head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!head_.compare_exchange_weak(head, node, std::memory_order_release,
+                                              std::memory_order_relaxed));
+        if (head == nullptr) {
+            wake_.notify_one();
+        }
+    }
+
+    // Destroy everything queued, including objects queued by the destructors that run meanwhile.
+    // Returns the number of objects destroyed.
+    static size_t Drain() {
+        size_t destroyed = 0;
+        while (Node* node = head_.exchange(nullptr, std::memory_order_acquire)) {
+            while (node != nullptr) {
+                Node* next = node->next;
+                node->destroy(node->object);
+                delete node;
+                node = next;
+                ++destroyed;
+            }
+        }
+        return destroyed;
+    }
+
+    static bool Empty() {
+        return head_.load(std::memory_order_relaxed) == nullptr;
+    }
+
+private:
+    friend class ReclaimThread;
+
+    struct Node {
+        void* object;
+        DestroyFn destroy;
+        Node* next;
+    };
+
+    static inline std::atomic<Node*> head_ = nullptr;
+    static inline std::mutex wake_mutex_;
+    // Best effort: pushers do not take `wake_mutex_`, so a wakeup may be missed and is then
+    // picked up by the periodic one.
+    static inline std::condition_variable wake_;
+};
+
+inline size_t DrainReclaimQueue() {
+    return ReclaimQueue::Drain();
+}
+
+// Background thread draining `ReclaimQueue` until it is destroyed. It wakes up when the queue
+// becomes non-empty and at least every `period`; the destructor drains whatever is left.
+class ReclaimThread {
+public:
+    explicit ReclaimThread(std::chrono::milliseconds period = std::chrono::milliseconds(10))
+        : period_(period), thread_([this] { Run(); }) {
+    }
+
+    ReclaimThread(const ReclaimThread&) = delete;
+    ReclaimThread& operator=(const ReclaimThread&) = delete;
+
+    ~ReclaimThread() {
+        {
+            std::lock_guard<std::mutex> lock(ReclaimQueue::wake_mutex_);
+            stop_ = true;
+        }
+        ReclaimQueue::wake_.notify_all();
+        thread_.join();
+        ReclaimQueue::Drain();
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(ReclaimQueue::wake_mutex_);
+        while (!stop_) {
+            lock.unlock();
+            ReclaimQueue::Drain();
+            lock.lock();
+            ReclaimQueue::wake_.wait_for(lock, period_,
+                                         [this] { return stop_ || !ReclaimQueue::Empty(); });
+        }
+    }
+
+    std::chrono::milliseconds period_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// Deleter for `UniquePtr` and `SharedPtr`: queues `ptr` to be released with `Inner` later.
+template <typename T, typename Inner = DefaultDeleter<T>>
+struct DeferredDeleter {
+    DeferredDeleter() = default;
+
+    template <class Derived, std::enable_if_t<std::is_convertible_v<Derived*, T*>, bool> = true>
+    DeferredDeleter(const DeferredDeleter<Derived>&) {
+    }
+
+    void operator()(T* ptr) {
+        ReclaimQueue::Push(ptr, [](void* object) { Inner()(static_cast<T*>(object)); });
+    }
+};
+
+// `RefCounted` deleter: queues the object to be destroyed with `Inner` later.
+template <typename Inner = DefaultDelete>
+struct DeferredDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        ReclaimQueue::Push(object, [](void* ptr) { Inner::Destroy(static_cast<T*>(ptr)); });
+    }
+};
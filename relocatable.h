@@ -0,0 +1,13 @@
+#pragma once
+
+#include <type_traits>
+
+// Objects of a trivially relocatable type can be moved to another address by copying their bytes:
+// the copy takes over, and the original is forgotten without running its destructor. Every
+// trivially copyable type qualifies. The smart pointers specialize this next to their definitions,
+// since they only hold pointers to objects that stay where they are.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable = IsTriviallyRelocatable<T>::value;
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "relocatable.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Minimal vector that moves `IsTriviallyRelocatable` elements with `memcpy`/`memmove`. Growing
+// or erasing from a vector of `SharedPtr`s then copies raw bytes instead of running a move
+// constructor and a destructor per element, and never touches a reference count. Other element
+// types fall back to the usual move-and-destroy.
+//
+// As for `std::vector`, growth gives the strong guarantee: elements whose move constructor may
+// throw are copied, and the old ones are destroyed only once all copies are in place.
+template <typename T>
+class RelocatingVector {
+public:
+    using Iterator = T*;
+    using ConstIterator = const T*;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    RelocatingVector() : data_(nullptr), size_(0), capacity_(0) {
+    }
+
+    RelocatingVector(std::initializer_list<T> values) : RelocatingVector() {
+        Reserve(values.size());
+        for (const T& value : values) {
+            PushBack(value);
+        }
+    }
+
+    RelocatingVector(const RelocatingVector& other) : RelocatingVector() {
+        Reserve(other.size_);
+        for (const T& value : other) {
+            PushBack(value);
+        }
+    }
+
+    RelocatingVector(RelocatingVector&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    RelocatingVector& operator=(const RelocatingVector& other) {
+        RelocatingVector(other).Swap(*this);
+        return *this;
+    }
+
+    RelocatingVector& operator=(RelocatingVector&& other) noexcept {
+        RelocatingVector(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~RelocatingVector() {
+        Clear();
+        Deallocate(data_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            Reallocate(capacity);
+        }
+    }
+
+    template <typename... Args>
+    T& EmplaceBack(Args&&... args) {
+        if (size_ == capacity_) {
+            // `args` may refer to an element, so build the new one before relocating
+            T value(std::forward<Args>(args)...);
+            Reallocate(capacity_ == 0 ? 1 : 2 * capacity_);
+            new (data_ + size_) T(std::move(value));
+        } else {
+            new (data_ + size_) T(std::forward<Args>(args)...);
+        }
+        return data_[size_++];
+    }
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    void PopBack() {
+        data_[--size_].~T();
+    }
+
+    // Erase `[first, last)` and close the gap. Returns the position following the erased range.
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        T* begin = data_ + (first - data_);
+        T* end = data_ + (last - data_);
+        if (begin == end) {
+            return begin;
+        }
+        if constexpr (kIsTriviallyRelocatable<T>) {
+            Destroy(begin, end);
+            std::memmove(static_cast<void*>(begin), static_cast<const void*>(end),
+                         (data_ + size_ - end) * sizeof(T));
+        } else {
+            T* tail = std::move(end, data_ + size_, begin);
+            Destroy(tail, data_ + size_);
+        }
+        size_ -= end - begin;
+        return begin;
+    }
+
+    Iterator Erase(ConstIterator position) {
+        return Erase(position, position + 1);
+    }
+
+    void Clear() {
+        Destroy(data_, data_ + size_);
+        size_ = 0;
+    }
+
+    void Swap(RelocatingVector& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    T* Data() {
+        return data_;
+    }
+
+    const T* Data() const {
+        return data_;
+    }
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    T& Back() {
+        return data_[size_ - 1];
+    }
+
+    const T& Back() const {
+        return data_[size_ - 1];
+    }
+
+    Iterator begin() {
+        return data_;
+    }
+
+    Iterator end() {
+        return data_ + size_;
+    }
+
+    ConstIterator begin() const {
+        return data_;
+    }
+
+    ConstIterator end() const {
+        return data_ + size_;
+    }
+
+private:
+    static T* Allocate(size_t capacity) {
+        if (capacity > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::length_error("RelocatingVector is too long");
+        }
+        return static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    static void Deallocate(T* data) {
+        ::operator delete(data, std::align_val_t(alignof(T)));
+    }
+
+    static void Destroy(T* first, T* last) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (; first != last; ++first) {
+                first->~T();
+            }
+        }
+    }
+
+    void Reallocate(size_t capacity) {
+        T* data = Allocate(capacity);
+        if constexpr (kIsTriviallyRelocatable<T>) {
+            if (size_ != 0) {
+                std::memcpy(static_cast<void*>(data), static_cast<const void*>(data_),
+                            size_ * sizeof(T));
+            }
+        } else {
+            // Old elements are destroyed only once all of them are in place, so a throwing copy
+            // leaves the vector as it was.
+            size_t built = 0;
+            try {
+                for (; built < size_; ++built) {
+                    new (data + built) T(std::move_if_noexcept(data_[built]));
+                }
+            } catch (...) {
+                Destroy(data, data + built);
+                Deallocate(data);
+                throw;
+            }
+            Destroy(data_, data_ + size_);
+        }
+        Deallocate(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    T* data_;
+    size_t size_;
+    size_t capacity_;
+};
@@ -3,57 +3,53 @@
 #include "sw_fwd.h"  // Forward declaration
 
 #include <cstddef>  // std::nullptr_t
+#include <type_traits>
 
-class ControlBlockBase {
-public:
-    ControlBlockBase() : shared_count_(1) {
-    }
-    virtual ~ControlBlockBase() {
-    }
-    virtual void DeleteData() {
-    }
+template <typename T, typename Counter = SimpleCounter, typename... Args>
+SharedPtr<T, Counter> MakeShared(Args&&... args);
 
-    size_t shared_count_ = 0;
-};
+template <typename T, typename Counter = SimpleCounter, typename Alloc, typename... Args>
+SharedPtr<T, Counter> AllocateShared(const Alloc& alloc, Args&&... args);
 
-template <typename T>
-class ControlBlockPointer : public ControlBlockBase {
-public:
-    ControlBlockPointer(T* ptr) : ptr_(ptr) {
-    }
-    virtual ~ControlBlockPointer() {
-        delete ptr_;
-    }
+template <typename T, typename Counter = SimpleCounter>
+SharedPtr<T, Counter> MakeSharedForOverwrite(size_t size);
 
-private:
-    T* ptr_;
-};
+// Defined in weak.h
+template <typename T, typename Counter = SimpleCounter>
+class EnableSharedFromThis;
 
-template <typename T>
-class ControlBlockInPlace : public ControlBlockBase {
-public:
-    template <typename... Args>
-    ControlBlockInPlace(Args&&... args) {
-        new (&buffer_) T(std::forward<Args>(args)...);
-    }
+// Point the `EnableSharedFromThis` base of a newly owned object at its control block, unless it
+// already refers to a live one. Defined in weak.h.
+template <typename U, typename Counter, typename Y>
+void AssignWeakThis(const EnableSharedFromThis<U, Counter>* base, Y* ptr,
+                    ControlBlockBase<Counter>* block);
 
-    virtual ~ControlBlockInPlace() {
-        GetPtr()->~T();
-    }
+// Objects without such a base.
+inline void AssignWeakThis(const volatile void*, const volatile void*, const void*) {
+}
 
-    T* GetPtr() {
-        return reinterpret_cast<T*>(&buffer_);
-    }
+// A base for another `Counter` would never be set, and `SharedFromThis` would always throw.
+template <typename U, typename Other, typename Y, typename Counter>
+void AssignWeakThis(const EnableSharedFromThis<U, Other>*, Y*, ControlBlockBase<Counter>*) {
+    static_assert(std::is_same_v<Other, Counter>,
+                  "EnableSharedFromThis<T, Counter> must use the Counter of the owning SharedPtr");
+}
 
-private:
-    alignas(T) char buffer_[sizeof(T)];
-};
+// `SharedPtr<T>` can take ownership of a `Y*`: `Y*` converts to `T*`, or for `T = U[]` the
+// array types convert (qualification only, no derived-to-base).
+template <typename Y, typename T>
+struct IsCompatiblePointer : std::is_convertible<Y*, T*> {};
+
+template <typename Y, typename T>
+struct IsCompatiblePointer<Y, T[]> : std::is_convertible<Y (*)[], T (*)[]> {};
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
-template <typename T>
+template <typename T, typename Counter>
 class SharedPtr {
 public:
     typedef T Type;
+    // `U` for `SharedPtr<U[]>`, which owns an array and is indexed with `operator[]`.
+    using ElementType = std::remove_extent_t<T>;
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
@@ -66,11 +62,35 @@ public:
     SharedPtr(std::nullptr_t) : SharedPtr() {
     }
 
-    explicit SharedPtr(T* ptr) : ptr_(ptr), control_block_(new ControlBlockPointer<T>(ptr)) {
+    explicit SharedPtr(ElementType* ptr)
+        : ptr_(ptr),
+          control_block_(NewPointerBlock(ptr, DefaultDeleterFor<ElementType>())) {
+        EnableWeakThis(ptr);
     }
 
-    template <typename Y, std::enable_if_t<std::is_convertible_v<Y*, T*>, bool> = true>
-    explicit SharedPtr(Y* ptr) : ptr_(ptr), control_block_(new ControlBlockPointer<Y>(ptr)) {
+    template <typename Y, std::enable_if_t<IsCompatiblePointer<Y, T>::value, bool> = true>
+    explicit SharedPtr(Y* ptr)
+        : ptr_(ptr),
+          control_block_(NewPointerBlock(ptr, DefaultDeleterFor<Y>())) {
+        EnableWeakThis(ptr);
+    }
+
+    // `deleter` is stored in the control block and called instead of `delete`. If the control
+    // block cannot be allocated, `deleter(ptr)` is called before the exception propagates.
+    template <typename Y, typename Deleter,
+              std::enable_if_t<IsCompatiblePointer<Y, T>::value, bool> = true>
+    SharedPtr(Y* ptr, Deleter deleter)
+        : ptr_(ptr), control_block_(NewPointerBlock(ptr, std::move(deleter))) {
+        EnableWeakThis(ptr);
+    }
+
+    // The control block is allocated through `alloc` and released with `deleter`.
+    template <typename Y, typename Deleter, typename Alloc,
+              std::enable_if_t<IsCompatiblePointer<Y, T>::value, bool> = true>
+    SharedPtr(Y* ptr, Deleter deleter, const Alloc& alloc)
+        : ptr_(ptr),
+          control_block_(NewPointerBlock(ptr, std::move(deleter), alloc)) {
+        EnableWeakThis(ptr);
     }
 
     SharedPtr(const SharedPtr& other) {
@@ -79,34 +99,33 @@ public:
         IncrementSharedCount();
     }
 
-    template <typename Y,
-              std::enable_if_t<std::is_convertible_v<typename Y::Type*, T*>, bool> = true>
-    SharedPtr(const Y& other) {
+    template <typename Y, std::enable_if_t<std::is_convertible_v<Y*, T*>, bool> = true>
+    SharedPtr(const SharedPtr<Y, Counter>& other) {
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
         IncrementSharedCount();
     }
 
-    SharedPtr(SharedPtr&& other) {
+    // Moves take over the reference of `other`, no counter is touched.
+    SharedPtr(SharedPtr&& other) noexcept {
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
-        IncrementSharedCount();
-        other.Reset();
+        other.ptr_ = nullptr;
+        other.control_block_ = nullptr;
     }
 
-    template <typename Y,
-              std::enable_if_t<std::is_convertible_v<typename Y::Type*, T*>, bool> = true>
-    SharedPtr(Y&& other) {
+    template <typename Y, std::enable_if_t<std::is_convertible_v<Y*, T*>, bool> = true>
+    SharedPtr(SharedPtr<Y, Counter>&& other) noexcept {
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
-        IncrementSharedCount();
-        other.Reset();
+        other.ptr_ = nullptr;
+        other.control_block_ = nullptr;
     }
 
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
+    SharedPtr(const SharedPtr<Y, Counter>& other, ElementType* ptr) {
         control_block_ = other.control_block_;
         IncrementSharedCount();
         ptr_ = ptr;
@@ -114,7 +133,8 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other);
+    // Throws `BadWeakPtr` if `other` has expired.
+    explicit SharedPtr(const WeakPtr<T, Counter>& other);
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
@@ -131,7 +151,7 @@ public:
         return *this;
     }
 
-    SharedPtr& operator=(SharedPtr&& other) {
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -148,35 +168,27 @@ public:
     // Destructor
 
     ~SharedPtr() {
-        if (control_block_) {
-            control_block_->shared_count_--;
-            if (control_block_->shared_count_ == 0) {
-                delete control_block_;
-                control_block_ = nullptr;
-            }
-        }
+        DecrementSharedCount();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
     void Reset() {
-        if (control_block_) {
-            control_block_->shared_count_--;
-            if (control_block_->shared_count_ == 0) {
-                delete control_block_;
-                control_block_ = nullptr;
-            }
-        }
+        DecrementSharedCount();
         control_block_ = nullptr;
         ptr_ = nullptr;
     }
 
-    template <typename Y, std::enable_if_t<std::is_convertible_v<Y*, T*>, bool> = true>
+    template <typename Y, std::enable_if_t<IsCompatiblePointer<Y, T>::value, bool> = true>
     void Reset(Y* ptr) {
-        Reset();
-        control_block_ = new ControlBlockPointer<Y>(ptr);
-        ptr_ = ptr;
+        SharedPtr(ptr).Swap(*this);
+    }
+
+    template <typename Y, typename Deleter,
+              std::enable_if_t<IsCompatiblePointer<Y, T>::value, bool> = true>
+    void Reset(Y* ptr, Deleter deleter) {
+        SharedPtr(ptr, std::move(deleter)).Swap(*this);
     }
 
     void Swap(SharedPtr& other) {
@@ -187,21 +199,26 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    ElementType* Get() const {
         return ptr_;
     }
 
-    T& operator*() const {
+    ElementType& operator*() const {
         return *ptr_;
     }
 
-    T* operator->() const {
+    ElementType* operator->() const {
         return ptr_;
     }
 
+    template <typename U = T, std::enable_if_t<std::is_array_v<U>, bool> = true>
+    ElementType& operator[](ptrdiff_t index) const {
+        return ptr_[index];
+    }
+
     size_t UseCount() const {
         if (control_block_) {
-            return control_block_->shared_count_;
+            return control_block_->SharedCount();
         }
         return 0;
     }
@@ -211,43 +228,162 @@ public:
     }
 
 private:
+    // What `SharedPtr(Y*)` releases the pointer with: `delete[]` for arrays, `delete` otherwise.
+    template <typename Y>
+    using DefaultDeleterFor = DefaultDeleter<std::conditional_t<std::is_array_v<T>, Y[], Y>>;
+
+    // Control block taking ownership of `ptr`. Like `std::shared_ptr`, releases `ptr` with
+    // `deleter` if the block cannot be created, so the resource never leaks.
+    template <typename Y, typename Deleter, typename Alloc = ControlBlockAlloc<Y>>
+    static ControlBlockBase<Counter>* NewPointerBlock(Y* ptr, Deleter deleter,
+                                                      const Alloc& alloc = Alloc()) {
+        try {
+            return NewControlBlock<ControlBlockPointer<Y, Counter, Deleter, Alloc>>(
+                alloc, ptr, std::move(deleter), alloc);
+        } catch (...) {
+            deleter(ptr);
+            throw;
+        }
+    }
+
+    // Called whenever a new object is taken over. Arrays have no weak-this.
+    template <typename Y>
+    void EnableWeakThis(Y* ptr) {
+        if constexpr (!std::is_array_v<T>) {
+            AssignWeakThis(ptr, ptr, control_block_);
+        }
+    }
+
     void IncrementSharedCount() {
         if (control_block_) {
-            ++control_block_->shared_count_;
+            TraceRef<ElementType>(RefOp::kInc);
+            control_block_->IncSharedRef();
         }
     }
 
-    T* ptr_;
+    void DecrementSharedCount() {
+        if (!control_block_) {
+            return;
+        }
+        TraceRef<ElementType>(RefOp::kDec);
+        if constexpr (std::is_final_v<T>) {
+            // Nothing derives from `T`, so blocks made by `MakeShared<T>` are the common case:
+            // check for them and release them without going through the dispatch table.
+            using Block = MakeSharedBlock<std::remove_cv_t<T>, Counter>;
+            if (control_block_->template Is<Block>()) {
+                control_block_->template DecSharedRefAs<Block>();
+                return;
+            }
+        }
+        control_block_->DecSharedRef();
+    }
 
-    template <typename Tp, typename... Args>
-    friend SharedPtr<Tp> MakeShared(Args&&... args);
+    ElementType* ptr_;
 
-    template <typename Tp>
+    template <typename Tp, typename C, typename A, typename... Args>
+    friend SharedPtr<Tp, C> AllocateShared(const A& alloc, Args&&... args);
+
+    template <typename Tp, typename C, typename A, typename Init>
+    friend SharedPtr<Tp, C> AllocateSharedArrayWith(const A& alloc, size_t size, Init init);
+
+    template <typename Tp, typename C>
     friend class SharedPtr;
 
-    ControlBlockBase* control_block_;
+    template <typename Tp, typename C>
+    friend class WeakPtr;
+
+    template <typename Tp, typename C>
+    friend class AtomicSharedPtr;
+
+    template <typename Tp, typename C>
+    friend class ThinSharedPtr;
+
+    template <typename D, typename Tp, typename C>
+    friend D* GetDeleter(const SharedPtr<Tp, C>& shared);
+
+    template <typename Ptr>
+    friend struct BulkRefs;
+
+    template <typename Tp>
+    friend class Borrowed;
+
+    ControlBlockBase<Counter>* control_block_;
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right);
+// The deleter `shared` was created with, or `nullptr` if it has none of type `D`.
+template <typename D, typename T, typename Counter>
+D* GetDeleter(const SharedPtr<T, Counter>& shared) {
+    if (!shared.control_block_) {
+        return nullptr;
+    }
+    return static_cast<D*>(shared.control_block_->GetDeleter(&TypeTag<D>::kId));
+}
 
-// Allocate memory only once
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    ControlBlockInPlace<T>* ptr = new ControlBlockInPlace<T>(std::forward<Args>(args)...);
-    SharedPtr<T> shared;
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<SharedPtr<T, Counter>> : std::true_type {};
+
+template <typename T, typename U, typename Counter>
+inline bool operator==(const SharedPtr<T, Counter>& left, const SharedPtr<U, Counter>& right);
+
+// One allocation for the block and all `size` elements, each constructed with `init(ptr)`.
+template <typename T, typename Counter, typename Alloc, typename Init>
+SharedPtr<T, Counter> AllocateSharedArrayWith(const Alloc& alloc, size_t size, Init init) {
+    static_assert(std::is_array_v<T> && std::extent_v<T> == 0, "Only `T[]` arrays are supported");
+    using Block = ControlBlockArray<std::remove_extent_t<T>, Counter, Alloc>;
+    Block* ptr = Block::Create(alloc, size, init);
+    SharedPtr<T, Counter> shared;
     shared.ptr_ = ptr->GetPtr();
     shared.control_block_ = ptr;
     return shared;
 }
 
-// Look for usage examples in tests
-template <typename T>
-class EnableSharedFromThis {
-public:
-    SharedPtr<T> SharedFromThis();
-    SharedPtr<const T> SharedFromThis() const;
+// `size` value-initialized elements
+template <typename T, typename Counter, typename Alloc>
+SharedPtr<T, Counter> AllocateSharedArray(const Alloc& alloc, size_t size) {
+    using Element = std::remove_extent_t<T>;
+    return AllocateSharedArrayWith<T, Counter>(alloc, size,
+                                               [](Element* ptr) { new (ptr) Element(); });
+}
+
+// `size` copies of `value`
+template <typename T, typename Counter, typename Alloc>
+SharedPtr<T, Counter> AllocateSharedArray(const Alloc& alloc, size_t size,
+                                          const std::remove_extent_t<T>& value) {
+    using Element = std::remove_extent_t<T>;
+    return AllocateSharedArrayWith<T, Counter>(
+        alloc, size, [&value](Element* ptr) { new (ptr) Element(value); });
+}
+
+// Allocate memory only once, through `alloc`. For `T = U[]` the arguments are `(size)` or
+// `(size, value)`.
+template <typename T, typename Counter, typename Alloc, typename... Args>
+SharedPtr<T, Counter> AllocateShared(const Alloc& alloc, Args&&... args) {
+    if constexpr (std::is_array_v<T>) {
+        return AllocateSharedArray<T, Counter>(alloc, std::forward<Args>(args)...);
+    } else {
+        using Block = MakeSharedBlock<T, Counter, Alloc>;
+        Block* ptr = NewControlBlock<Block>(alloc, alloc, std::forward<Args>(args)...);
+        SharedPtr<T, Counter> shared;
+        shared.ptr_ = ptr->GetPtr();
+        shared.control_block_ = ptr;
+        shared.EnableWeakThis(shared.ptr_);
+        return shared;
+    }
+}
+
+// Allocate memory only once
+template <typename T, typename Counter, typename... Args>
+SharedPtr<T, Counter> MakeShared(Args&&... args) {
+    return AllocateShared<T, Counter>(ControlBlockAlloc<std::remove_extent_t<T>>(),
+                                      std::forward<Args>(args)...);
+}
+
+// `MakeShared<T[]>(size)` leaving the elements default-initialized, i.e. trivial ones are not
+// zeroed. For buffers that are about to be overwritten anyway.
+template <typename T, typename Counter>
+SharedPtr<T, Counter> MakeSharedForOverwrite(size_t size) {
+    using Element = std::remove_extent_t<T>;
+    return AllocateSharedArrayWith<T, Counter>(ControlBlockAlloc<Element>(), size,
+                                               [](Element* ptr) { new (ptr) Element; });
+}
 
-    WeakPtr<T> WeakFromThis() noexcept;
-    WeakPtr<const T> WeakFromThis() const noexcept;
-};
@@ -1,54 +1,602 @@
 #pragma once
 
+#include "accounting.h"
+#include "borrow_check.h"
+#include "compressed_pair.h"
+#include "counter.h"
+#include "relocatable.h"
+#include "trace.h"
+#include "unique.h"  // DefaultDeleter
+
+#include <algorithm>  // std::max
+#include <atomic>
+#include <cstddef>
+#include <cstdint>  // SIZE_MAX
 #include <exception>
+#include <memory>  // std::allocator, std::allocator_traits
+#include <new>
+#include <type_traits>
+#include <utility>
 
-class ControlBlockBase {
+// Build with -DSMART_POINTERS_BLOCK_POOL to serve the control blocks of `SharedPtr(Y*)`,
+// `Reset(Y*)` and `MakeShared` from the thread-caching `BlockPool`. `AllocateShared` and
+// `SharedPtr(Y*, Deleter, Alloc)` take `PoolAllocator` explicitly either way.
+#ifdef SMART_POINTERS_BLOCK_POOL
+#include "block_pool.h"
+
+template <typename T>
+using ControlBlockAlloc = PoolAllocator<T>;
+#else
+template <typename T>
+using ControlBlockAlloc = std::allocator<T>;
+#endif
+
+template <typename T, typename Counter = SimpleCounter>
+class SharedPtr;
+
+template <typename T, typename Counter = SimpleCounter>
+class WeakPtr;
+
+template <typename T, typename Counter = AtomicCounter>
+class AtomicSharedPtr;
+
+template <typename T, typename Counter = SimpleCounter>
+class ThinSharedPtr;
+
+// Counter used for the weak count of a block counting strong references with `Counter`.
+template <typename Counter>
+struct WeakCounterFor {
+    using Type = Counter;
+};
+
+// Counters that can finish a release outside of their own `DecRef` (see biased.h) are told which
+// block they live in. All the others ignore it.
+template <typename Counter, typename Block>
+void AttachCounter(Counter&, Block*) {
+}
+
+// Shared and weak counts of a control block: by default two separate `Counter`s. Layouts that
+// pack them into one word or drop the weak count are in packed.h. Interface:
+//   IncShared(), TryIncShared()  - add a strong reference (the latter only if there still is one);
+//   DecShared()                  - drop a strong reference and tell what is left (`RefsLeft`);
+//   AddShared(n), SubShared(n)   - add or drop `n` strong references at once; the caller of
+//                                  `SubShared` keeps another one, so the count stays above zero;
+//   IncWeak(), DecWeak()         - the same for weak references, `DecWeak` is true at zero;
+//   SharedCount();
+//   kHasWeak                     - false if `WeakPtr` cannot be used.
+// What is left of an object's references once `DecShared` dropped a strong one.
+enum class RefsLeft {
+    kStrong,  // other strong references
+    kWeak,    // no strong ones, the weak count decides the block
+    kNone,    // nothing; the weak count is left as it is and the caller frees everything
+};
+
+template <typename Counter>
+class SeparateCounts {
 public:
-    ControlBlockBase() : shared_count_(1) {
+    static constexpr bool kHasWeak = true;
+
+    template <typename Block>
+    explicit SeparateCounts(Block* block) : shared_(1), weak_(1) {
+        AttachCounter(shared_, block);
+    }
+
+    void IncShared() {
+        shared_.IncRef();
+    }
+    bool TryIncShared() {
+        return shared_.IncRefIfNotZero();
     }
-    virtual ~ControlBlockBase() {
+    // The counters cannot be read together, so the weak count always decides.
+    RefsLeft DecShared() {
+        return (shared_.DecRef() == 0) ? RefsLeft::kWeak : RefsLeft::kStrong;
     }
-    virtual void DeleteData() {
+    void AddShared(size_t n) {
+        AddRefs(shared_, n);
+    }
+    void SubShared(size_t n) {
+        SubRefs(shared_, n);
+    }
+
+    void IncWeak() {
+        weak_.IncRef();
+    }
+    bool DecWeak() {
+        return weak_.DecRef() == 0;
+    }
+
+    size_t SharedCount() const {
+        return shared_.RefCount();
     }
 
-    size_t shared_count_ = 0;
-    size_t weak_count_ = 0;
+private:
+    Counter shared_;
+    typename WeakCounterFor<Counter>::Type weak_;
 };
 
+template <typename Counter>
+struct BlockCountsFor {
+    using Type = SeparateCounts<Counter>;
+};
+
+template <typename Counter>
+class ControlBlockBase;
+
+// Address identifying the type `T`, so blocks can be queried for their deleter without RTTI.
 template <typename T>
-class ControlBlockPointer : public ControlBlockBase {
+struct TypeTag {
+    static constexpr char kId = 0;
+};
+
+// Per-type operations of a control block, used instead of a vtable. Blocks keep one pointer to a
+// static table and have no virtual destructor, so the last release costs at most two indirect
+// calls and none when the caller knows the block type (see `DecSharedRefAs`).
+template <typename Counter>
+struct ControlBlockOps {
+    // Destroy the object once the last strong reference is gone.
+    void (*delete_data)(ControlBlockBase<Counter>*);
+    // Destroy and free the block itself, through whatever allocated it.
+    void (*delete_block)(ControlBlockBase<Counter>*);
+    // The stored deleter if its `TypeTag` is `tag`, `nullptr` otherwise.
+    void* (*get_deleter)(ControlBlockBase<Counter>*, const void* tag);
+    // Bytes of the destroyed object the block keeps while only weak references are left.
+    size_t (*pinned_bytes)(ControlBlockBase<Counter>*);
+    // Add `bytes` to the weak-pinned bytes of the block's type in `SnapshotBlockStats()`.
+    void (*account_pinned)(int64_t bytes);
+};
+
+template <typename Block, typename Counter>
+struct ControlBlockDispatch {
+    static void DeleteData(ControlBlockBase<Counter>* block) {
+        static_cast<Block*>(block)->DeleteData();
+    }
+    static void DeleteBlock(ControlBlockBase<Counter>* block) {
+        static_cast<Block*>(block)->DeleteBlock();
+    }
+    static void* GetDeleter(ControlBlockBase<Counter>* block, const void* tag) {
+        return static_cast<Block*>(block)->GetDeleter(tag);
+    }
+    static size_t PinnedBytes(ControlBlockBase<Counter>* block) {
+        return static_cast<Block*>(block)->PinnedBytes();
+    }
+    static void AccountPinned(int64_t bytes) {
+        BlockAccounting<typename Block::ElementType>::Pinned(bytes);
+    }
+
+    static constexpr ControlBlockOps<Counter> kOps = {&DeleteData, &DeleteBlock, &GetDeleter,
+                                                      &PinnedBytes, &AccountPinned};
+};
+
+// Object bytes held by blocks whose object is gone but which still have weak references, see
+// `WeakPinnedBytes()`. Only touched when a block actually outlives its object. The last weak
+// reference may be dropped on another thread before the pin is recorded, so the running total
+// can dip below zero for a moment; it is signed and read clamped.
+class WeakPinned {
 public:
-    ControlBlockPointer(T* ptr) : ptr_(ptr) {
+    static void Add(size_t bytes) {
+        if (bytes != 0) {
+            bytes_.fetch_add(static_cast<ptrdiff_t>(bytes), std::memory_order_relaxed);
+        }
+    }
+
+    static void Remove(size_t bytes) {
+        if (bytes != 0) {
+            bytes_.fetch_sub(static_cast<ptrdiff_t>(bytes), std::memory_order_relaxed);
+        }
     }
-    virtual ~ControlBlockPointer() = default;
-    virtual void DeleteData() override {
-        delete ptr_;
+
+    static size_t Bytes() {
+        ptrdiff_t bytes = bytes_.load(std::memory_order_relaxed);
+        return (bytes > 0 ? static_cast<size_t>(bytes) : 0);
     }
 
 private:
-    T* ptr_;
+    static inline std::atomic<ptrdiff_t> bytes_ = 0;
 };
 
+// Memory currently kept alive only by `WeakPtr`s to objects that were allocated together with
+// their control block (`MakeShared`) and have already been destroyed.
+inline size_t WeakPinnedBytes() {
+    return WeakPinned::Bytes();
+}
+
+// `Counter` is the counting policy, same as in `RefCounted`: `SimpleCounter` for objects that stay
+// on one thread, `AtomicCounter` for objects shared between threads. `PackedCounter` and
+// `NoWeak<Counter>` (packed.h) select smaller layouts of the counts.
+//
+// All strong references together hold one weak reference, so the block is freed by whoever drops
+// the last weak one and nobody has to look at both counters at once.
+template <typename Counter>
+class ControlBlockBase {
+public:
+    using Counts = typename BlockCountsFor<Counter>::Type;
+
+    explicit ControlBlockBase(const ControlBlockOps<Counter>* ops) : ops_(ops), counts_(this) {
+    }
+
+    void IncSharedRef() {
+        counts_.IncShared();
+    }
+
+    // Promote a weak reference. Fails once the object has been destroyed.
+    bool TryIncSharedRef() {
+        return counts_.TryIncShared();
+    }
+
+    void DecSharedRef() {
+        RefsLeft left = counts_.DecShared();
+        if (left == RefsLeft::kNone) {
+            ops_->delete_data(this);
+            ops_->delete_block(this);
+        } else if (left == RefsLeft::kWeak) {
+            ReleaseLastShared();
+        }
+    }
+
+    // `n` strong references at once, see bulk.h.
+    void AddSharedRefs(size_t n) {
+        counts_.AddShared(n);
+    }
+
+    void DecSharedRefs(size_t n) {
+        if (n > 1) {
+            counts_.SubShared(n - 1);
+        }
+        DecSharedRef();
+    }
+
+    // `DecSharedRef` for a caller that knows the block is a `Block`: no indirect calls, and the
+    // destructor of the object can be inlined.
+    template <typename Block>
+    void DecSharedRefAs() {
+        Block* block = static_cast<Block*>(this);
+        RefsLeft left = counts_.DecShared();
+        if (left == RefsLeft::kNone) {
+            block->DeleteData();
+            block->DeleteBlock();
+        } else if (left == RefsLeft::kWeak) {
+            block->DeleteData();
+            // Once our weak reference is dropped the block may be freed by someone else.
+            size_t pinned = block->PinnedBytes();
+            if (counts_.DecWeak()) {
+                block->DeleteBlock();
+            } else {
+                WeakPinned::Add(pinned);
+                BlockAccounting<typename Block::ElementType>::Pinned(static_cast<int64_t>(pinned));
+            }
+        }
+    }
+
+    void ReleaseLastShared() {
+        // The table is static, so it stays usable after the block may have been freed.
+        const ControlBlockOps<Counter>* ops = ops_;
+        ops->delete_data(this);
+        size_t pinned = ops->pinned_bytes(this);
+        if (counts_.DecWeak()) {
+            ops->delete_block(this);
+        } else {
+            WeakPinned::Add(pinned);
+            AccountPinned(ops, static_cast<int64_t>(pinned));
+        }
+    }
+
+    void IncWeakRef() {
+        static_assert(Counts::kHasWeak, "This counter keeps no weak count, WeakPtr is disabled");
+        counts_.IncWeak();
+    }
+
+    // Never drops the reference held by the strong ones, so the object is already gone when this
+    // frees the block.
+    void DecWeakRef() {
+        if (counts_.DecWeak()) {
+            size_t pinned = ops_->pinned_bytes(this);
+            WeakPinned::Remove(pinned);
+            AccountPinned(ops_, -static_cast<int64_t>(pinned));
+            ops_->delete_block(this);
+        }
+    }
+
+    size_t SharedCount() const {
+        return counts_.SharedCount();
+    }
+
+    void* GetDeleter(const void* tag) {
+        return ops_->get_deleter(this, tag);
+    }
+
+    template <typename Block>
+    bool Is() const {
+        return ops_ == &ControlBlockDispatch<Block, Counter>::kOps;
+    }
+
+private:
+    static void AccountPinned(const ControlBlockOps<Counter>* ops, int64_t bytes) {
+        if constexpr (kAccountBlocks) {
+            if (bytes != 0) {
+                ops->account_pinned(bytes);
+            }
+        }
+    }
+
+    const ControlBlockOps<Counter>* ops_;
+    Counts counts_;
+};
+
+template <typename Alloc, typename Block>
+using ReboundAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+
+// Allocate a `Block` through `alloc` rebound to it. The block keeps a copy of the allocator and
+// frees itself with `DeleteBlockThrough`.
+template <typename Block, typename Alloc, typename... Args>
+Block* NewControlBlock(const Alloc& alloc, Args&&... args) {
+    using Traits = std::allocator_traits<ReboundAlloc<Alloc, Block>>;
+    ReboundAlloc<Alloc, Block> block_alloc(alloc);
+    Block* block = Traits::allocate(block_alloc, 1);
+    try {
+        new (block) Block(std::forward<Args>(args)...);
+    } catch (...) {
+        Traits::deallocate(block_alloc, block, 1);
+        throw;
+    }
+    TraceRef<typename Block::ElementType>(RefOp::kAlloc);
+    return block;
+}
+
+// `units` is the number of `Block`-sized units the block was allocated with.
+template <typename Block, typename Alloc>
+void DeleteBlockThrough(Block* block, const Alloc& alloc, size_t units = 1) {
+    TraceRef<typename Block::ElementType>(RefOp::kFree);
+    ReboundAlloc<Alloc, Block> block_alloc(alloc);
+    block->~Block();
+    std::allocator_traits<ReboundAlloc<Alloc, Block>>::deallocate(block_alloc, block, units);
+}
+
+// Owns `ptr` and releases it with `Deleter`. Stateless deleters and allocators take no space.
+template <typename T, typename Counter, typename Deleter = DefaultDeleter<T>,
+          typename Alloc = ControlBlockAlloc<T>>
+class ControlBlockPointer : public ControlBlockBase<Counter> {
+public:
+    using ElementType = T;
+
+    ControlBlockPointer(T* ptr, Deleter deleter = Deleter(), const Alloc& alloc = Alloc())
+        : ControlBlockBase<Counter>(&ControlBlockDispatch<ControlBlockPointer, Counter>::kOps),
+          ptr_(ptr, CompressedPair<Deleter, Alloc>(std::move(deleter), alloc)) {
+        BlockAccounting<T>::Created(Count());
+    }
+
+    void DeleteData() {
+        BorrowCheck::Released(static_cast<ControlBlockBase<Counter>*>(this));
+        BlockAccounting<T>::Destroyed(Count());
+        ptr_.GetSecond().GetFirst()(ptr_.GetFirst());
+    }
+    void DeleteBlock() {
+        BlockAccounting<T>::Freed();
+        Alloc alloc(ptr_.GetSecond().GetSecond());
+        DeleteBlockThrough(this, alloc);
+    }
+    void* GetDeleter(const void* tag) {
+        return (tag == &TypeTag<Deleter>::kId ? &ptr_.GetSecond().GetFirst() : nullptr);
+    }
+    size_t PinnedBytes() {
+        return 0;
+    }
+
+private:
+    size_t Count() const {
+        return (ptr_.GetFirst() != nullptr ? 1 : 0);
+    }
+
+    CompressedPair<T*, CompressedPair<Deleter, Alloc>> ptr_;
+};
+
+// Uninitialized storage for a `T`; the user-provided constructor keeps value-initialization
+// from zeroing it.
 template <typename T>
-class ControlBlockInPlace : public ControlBlockBase {
+struct RawStorage {
+    RawStorage() {
+    }
+
+    alignas(T) char bytes[sizeof(T)];
+};
+
+template <typename T, typename Counter, typename Alloc = ControlBlockAlloc<T>>
+class ControlBlockInPlace : public ControlBlockBase<Counter> {
 public:
+    using ElementType = T;
+
     template <typename... Args>
-    ControlBlockInPlace(Args&&... args) {
-        new (&buffer_) T(std::forward<Args>(args)...);
+    ControlBlockInPlace(const Alloc& alloc, Args&&... args)
+        : ControlBlockBase<Counter>(&ControlBlockDispatch<ControlBlockInPlace, Counter>::kOps),
+          buffer_(alloc) {
+        new (GetPtr()) T(std::forward<Args>(args)...);
+        BlockAccounting<T>::Created(1);
     }
 
-    virtual ~ControlBlockInPlace() = default;
-
-    virtual void DeleteData() override {
+    void DeleteData() {
+        BorrowCheck::Released(static_cast<ControlBlockBase<Counter>*>(this));
         GetPtr()->~T();
+        BlockAccounting<T>::Destroyed(1);
+    }
+    void DeleteBlock() {
+        BlockAccounting<T>::Freed();
+        Alloc alloc(buffer_.GetFirst());
+        DeleteBlockThrough(this, alloc);
+    }
+    void* GetDeleter(const void*) {
+        return nullptr;
+    }
+    size_t PinnedBytes() {
+        return sizeof(T);
     }
 
     T* GetPtr() {
-        return reinterpret_cast<T*>(&buffer_);
+        return reinterpret_cast<T*>(&buffer_.GetSecond().bytes);
     }
 
 private:
-    alignas(T) char buffer_[sizeof(T)];
+    CompressedPair<Alloc, RawStorage<T>> buffer_;
 };
 
-class BadWeakPtr : public std::exception {};
\ No newline at end of file
+// Block of a `MakeShared` object that gets its own allocation (see `SplitPayload`). The object's
+// memory is returned as soon as the last strong reference is gone, and only the block itself
+// stays around for the weak references.
+template <typename T, typename Counter, typename Alloc = ControlBlockAlloc<T>>
+class ControlBlockSplit : public ControlBlockBase<Counter> {
+public:
+    using ElementType = T;
+
+    template <typename... Args>
+    ControlBlockSplit(const Alloc& alloc, Args&&... args)
+        : ControlBlockBase<Counter>(&ControlBlockDispatch<ControlBlockSplit, Counter>::kOps),
+          ptr_(alloc, nullptr) {
+        using Traits = std::allocator_traits<ReboundAlloc<Alloc, RawStorage<T>>>;
+        ReboundAlloc<Alloc, RawStorage<T>> payload_alloc(alloc);
+        RawStorage<T>* storage = Traits::allocate(payload_alloc, 1);
+        try {
+            new (storage->bytes) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Traits::deallocate(payload_alloc, storage, 1);
+            throw;
+        }
+        TraceRef<T>(RefOp::kAlloc);
+        ptr_.GetSecond() = reinterpret_cast<T*>(storage->bytes);
+        BlockAccounting<T>::Created(1);
+    }
+
+    void DeleteData() {
+        BorrowCheck::Released(static_cast<ControlBlockBase<Counter>*>(this));
+        T* ptr = GetPtr();
+        ptr->~T();
+        BlockAccounting<T>::Destroyed(1);
+        TraceRef<T>(RefOp::kFree);
+        ReboundAlloc<Alloc, RawStorage<T>> payload_alloc(ptr_.GetFirst());
+        std::allocator_traits<ReboundAlloc<Alloc, RawStorage<T>>>::deallocate(
+            payload_alloc, reinterpret_cast<RawStorage<T>*>(ptr), 1);
+    }
+    void DeleteBlock() {
+        BlockAccounting<T>::Freed();
+        Alloc alloc(ptr_.GetFirst());
+        DeleteBlockThrough(this, alloc);
+    }
+    void* GetDeleter(const void*) {
+        return nullptr;
+    }
+    size_t PinnedBytes() {
+        return 0;
+    }
+
+    T* GetPtr() {
+        return ptr_.GetSecond();
+    }
+
+private:
+    CompressedPair<Alloc, T*> ptr_;
+};
+
+#ifndef SMART_POINTERS_SPLIT_PAYLOAD_SIZE
+#define SMART_POINTERS_SPLIT_PAYLOAD_SIZE 1024
+#endif
+
+// Whether `MakeShared<T>` and `AllocateShared<T>` put the object in a separate allocation
+// (`ControlBlockSplit`) instead of inside the block. That costs a second allocation but stops
+// weak references from pinning the object's memory, so it is the default for objects of at least
+// SMART_POINTERS_SPLIT_PAYLOAD_SIZE bytes. Specialize it to choose per type.
+template <typename T>
+struct SplitPayload : std::bool_constant<(sizeof(T) >= SMART_POINTERS_SPLIT_PAYLOAD_SIZE)> {};
+
+// Block that `AllocateShared<T, Counter>(Alloc)` creates.
+template <typename T, typename Counter, typename Alloc = ControlBlockAlloc<T>>
+using MakeSharedBlock = std::conditional_t<SplitPayload<T>::value,
+                                           ControlBlockSplit<T, Counter, Alloc>,
+                                           ControlBlockInPlace<T, Counter, Alloc>>;
+
+// Block of `MakeShared<T[]>(size)`: the header is followed by `size` elements of `T` in the same
+// allocation. The class is aligned for `T` too, so the elements start right past the header.
+template <typename T, typename Counter, typename Alloc = ControlBlockAlloc<T>>
+class alignas(std::max(alignof(T), alignof(ControlBlockBase<Counter>))) ControlBlockArray
+    : public ControlBlockBase<Counter> {
+public:
+    using ElementType = T;
+
+    // `init(ptr)` constructs one element at `ptr`. Elements constructed before a throwing one are
+    // destroyed and the memory is released.
+    template <typename Init>
+    static ControlBlockArray* Create(const Alloc& alloc, size_t size, Init init) {
+        using Traits = std::allocator_traits<ReboundAlloc<Alloc, ControlBlockArray>>;
+        if (size > (SIZE_MAX - 2 * sizeof(ControlBlockArray)) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        ReboundAlloc<Alloc, ControlBlockArray> block_alloc(alloc);
+        ControlBlockArray* block = Traits::allocate(block_alloc, Units(size));
+        new (block) ControlBlockArray(alloc, size);
+        T* elements = block->GetPtr();
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                init(elements + constructed);
+            }
+        } catch (...) {
+            Destroy(elements, constructed);
+            block->~ControlBlockArray();
+            Traits::deallocate(block_alloc, block, Units(size));
+            throw;
+        }
+        TraceRef<T>(RefOp::kAlloc);
+        BlockAccounting<T>::Created(size);
+        return block;
+    }
+
+    void DeleteData() {
+        BorrowCheck::Released(static_cast<ControlBlockBase<Counter>*>(this));
+        Destroy(GetPtr(), Size());
+        BlockAccounting<T>::Destroyed(Size());
+    }
+    void DeleteBlock() {
+        BlockAccounting<T>::Freed();
+        Alloc alloc(size_.GetFirst());
+        DeleteBlockThrough(this, alloc, Units(Size()));
+    }
+    void* GetDeleter(const void*) {
+        return nullptr;
+    }
+    size_t PinnedBytes() {
+        return Size() * sizeof(T);
+    }
+
+    T* GetPtr() {
+        return reinterpret_cast<T*>(this + 1);
+    }
+
+    size_t Size() const {
+        return size_.GetSecond();
+    }
+
+private:
+    ControlBlockArray(const Alloc& alloc, size_t size)
+        : ControlBlockBase<Counter>(&ControlBlockDispatch<ControlBlockArray, Counter>::kOps),
+          size_(alloc, size) {
+    }
+
+    // Header plus elements, rounded up to whole blocks.
+    static size_t Units(size_t size) {
+        return (sizeof(ControlBlockArray) + size * sizeof(T) + sizeof(ControlBlockArray) - 1) /
+               sizeof(ControlBlockArray);
+    }
+
+    // In reverse order of construction.
+    static void Destroy(T* elements, size_t size) {
+        while (size != 0) {
+            elements[--size].~T();
+        }
+    }
+
+    CompressedPair<Alloc, size_t> size_;
+};
+
+class BadWeakPtr : public std::exception {};
+
+// A `SharedPtr` that does not own a `MakeShared` object was converted to a `ThinSharedPtr`.
+class BadThinPtr : public std::exception {};
+
+// `Borrowed::Promote` to `IntrusivePtr` of an object that no `IntrusivePtr` owns.
+class BadPromote : public std::exception {};
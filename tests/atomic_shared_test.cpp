@@ -0,0 +1,160 @@
+// `AtomicSharedPtr` (atomic_shared.h) under concurrent `Store`, `Load`, `Exchange` and
+// `CompareExchange`. Every value must be seen whole, and every object must be destroyed exactly
+// once.
+
+#include "atomic_shared.h"
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what, const char* test) {
+    if (!condition) {
+        std::fprintf(stderr, "%s: %s\n", test, what);
+        ++failures;
+    }
+}
+
+std::atomic<int64_t> live = 0;
+
+// `check` always derives from `value`, so a torn or freed object is likely to break it.
+struct Tracked {
+    explicit Tracked(int64_t value) : value(value), check(~value) {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Tracked() {
+        check = value;
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool Whole() const {
+        return check == ~value;
+    }
+
+    int64_t value;
+    int64_t check;
+};
+
+using Ptr = SharedPtr<Tracked, AtomicCounter>;
+using Slot = AtomicSharedPtr<Tracked, AtomicCounter>;
+
+constexpr size_t kThreads = 4;
+constexpr size_t kIterations = 20000;
+
+template <typename Body>
+void RunThreads(Body body) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back(body, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Store / Load
+
+// Half the threads replace the value, the other half read it. Readers keep their copies for a
+// while, so nodes are retired while still borrowed.
+void StoreAndLoad() {
+    std::atomic<size_t> torn = 0;
+    {
+        Slot slot(MakeShared<Tracked, AtomicCounter>(0));
+        RunThreads([&](size_t index) {
+            if (index % 2 == 0) {
+                for (size_t i = 0; i < kIterations; ++i) {
+                    slot.Store(MakeShared<Tracked, AtomicCounter>(static_cast<int64_t>(i)));
+                }
+                return;
+            }
+            std::vector<Ptr> kept(16);
+            for (size_t i = 0; i < kIterations; ++i) {
+                Ptr ptr = slot.Load();
+                if (!ptr || !ptr->Whole()) {
+                    torn.fetch_add(1, std::memory_order_relaxed);
+                }
+                kept[i % kept.size()] = std::move(ptr);
+            }
+        });
+        Check(torn.load() == 0, "a load returned a null or torn value", __func__);
+    }
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Exchange
+
+// Every object stored is handed out exactly once: by an `Exchange` or by the final value.
+void ExchangeHandsOutEachValueOnce() {
+    std::atomic<int64_t> sum = 0;
+    {
+        Slot slot(MakeShared<Tracked, AtomicCounter>(0));
+        RunThreads([&](size_t index) {
+            for (size_t i = 0; i < kIterations; ++i) {
+                int64_t value = static_cast<int64_t>(index * kIterations + i + 1);
+                Ptr old = slot.Exchange(MakeShared<Tracked, AtomicCounter>(value));
+                sum.fetch_add(old->value, std::memory_order_relaxed);
+            }
+        });
+        sum += slot.Load()->value;
+    }
+    int64_t total = static_cast<int64_t>(kThreads * kIterations);
+    Check(sum.load() == total * (total + 1) / 2, "values lost or handed out twice", __func__);
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CompareExchange
+
+// Threads increment a shared value by replacing it with a successor. Lost updates show up in the
+// final value, and readers race the replaced nodes.
+void CompareExchangeIncrements() {
+    int64_t final_value = 0;
+    std::atomic<size_t> torn = 0;
+    {
+        Slot slot(MakeShared<Tracked, AtomicCounter>(0));
+        RunThreads([&](size_t index) {
+            if (index == 0) {
+                for (size_t i = 0; i < kIterations; ++i) {
+                    if (!slot.Load()->Whole()) {
+                        torn.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                return;
+            }
+            for (size_t i = 0; i < kIterations; ++i) {
+                Ptr expected = slot.Load();
+                while (!slot.CompareExchange(
+                    expected, MakeShared<Tracked, AtomicCounter>(expected->value + 1))) {
+                }
+            }
+        });
+        final_value = slot.Load()->value;
+    }
+    Check(torn.load() == 0, "a load returned a torn value", __func__);
+    Check(final_value == static_cast<int64_t>((kThreads - 1) * kIterations), "updates were lost",
+          __func__);
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+}
+
+}  // namespace
+
+int main() {
+    StoreAndLoad();
+    ExchangeHandsOutEachValueOnce();
+    CompareExchangeIncrements();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
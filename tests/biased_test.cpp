@@ -0,0 +1,207 @@
+// Biased counting (biased.h) under concurrent hand-overs: references move between the owner and
+// other threads, so both halves of the count change at once and blocks get queued, merged and
+// handed back in every order. Every object must be destroyed exactly once.
+
+#include "biased.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what, const char* test) {
+    if (!condition) {
+        std::fprintf(stderr, "%s: %s\n", test, what);
+        ++failures;
+    }
+}
+
+std::atomic<int64_t> live = 0;
+
+struct Tracked {
+    Tracked() {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Tracked() {
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    int64_t value = 1;
+};
+
+using Ptr = SharedPtr<Tracked, BiasedCounter>;
+using Weak = WeakPtr<Tracked, BiasedCounter>;
+
+// Blocking queue between two threads.
+template <typename T>
+class Mailbox {
+public:
+    void Push(T value) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_.push_back(std::move(value));
+        }
+        ready_.notify_one();
+    }
+
+    // Waits for an item; false once the mailbox is closed and empty.
+    bool Pop(T& value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return false;
+        }
+        value = std::move(items_.front());
+        items_.pop_front();
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) {
+            return false;
+        }
+        value = std::move(items_.front());
+        items_.pop_front();
+        return true;
+    }
+
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+constexpr size_t kRounds = 20000;
+constexpr size_t kWorkers = 2;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hand-over racing the owner's merge
+
+// The owner makes two references and gives both away. One is dropped elsewhere, which drives the
+// non-owner half negative and queues the block; the other is copied twice and the copies come
+// back to the owner, whose drops take its half to zero, possibly while the block is still being
+// handed over.
+void HandOverRacesMerge() {
+    Mailbox<Ptr> to_droppers[kWorkers];
+    Mailbox<Ptr> to_copiers[kWorkers];
+    Mailbox<Ptr> returned;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < kWorkers; ++i) {
+        workers.emplace_back([&, i] {
+            Ptr ptr;
+            while (to_droppers[i].Pop(ptr)) {
+                Weak weak(ptr);
+                ptr.Reset();
+                // Races the owner's drops of the last references.
+                weak.Lock().Reset();
+            }
+        });
+        workers.emplace_back([&, i] {
+            Ptr ptr;
+            while (to_copiers[i].Pop(ptr)) {
+                returned.Push(ptr);
+                returned.Push(ptr);
+                ptr.Reset();
+            }
+        });
+    }
+
+    std::thread owner([&] {
+        size_t received = 0;
+        Ptr back;
+        for (size_t round = 0; round < kRounds; ++round) {
+            Ptr ptr = MakeShared<Tracked, BiasedCounter>();
+            Ptr copy = ptr;
+            to_droppers[round % kWorkers].Push(std::move(ptr));
+            to_copiers[round % kWorkers].Push(std::move(copy));
+            while (returned.TryPop(back)) {
+                back.Reset();
+                ++received;
+            }
+            if (round % 64 == 0) {
+                DrainBiasedQueue();
+            }
+        }
+        while (received < 2 * kRounds && returned.Pop(back)) {
+            back.Reset();
+            ++received;
+        }
+        DrainBiasedQueue();
+    });
+
+    owner.join();
+    for (size_t i = 0; i < kWorkers; ++i) {
+        to_droppers[i].Close();
+        to_copiers[i].Close();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Owner exit
+
+// The owner exits while other threads still hold its references; they merge the blocks
+// themselves when they drop them.
+void OwnerExits() {
+    std::vector<Ptr> handed;
+    std::thread owner([&] {
+        for (size_t i = 0; i < kRounds; ++i) {
+            Ptr ptr = MakeShared<Tracked, BiasedCounter>();
+            handed.push_back(ptr);
+            handed.push_back(std::move(ptr));
+        }
+    });
+    owner.join();
+    Check(live.load() == static_cast<int64_t>(kRounds), "objects destroyed too early", __func__);
+
+    std::vector<std::thread> droppers;
+    for (size_t i = 0; i < kWorkers; ++i) {
+        droppers.emplace_back([&, i] {
+            for (size_t j = i; j < handed.size(); j += kWorkers) {
+                handed[j].Reset();
+            }
+        });
+    }
+    for (std::thread& dropper : droppers) {
+        dropper.join();
+    }
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+}
+
+}  // namespace
+
+int main() {
+    HandOverRacesMerge();
+    OwnerExits();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Epoch-based reclamation (epoch.h): readers inside an `EpochGuard` follow raw pointers to objects
+// that writers retire meanwhile. No object may be destroyed while a reader can still see it, and
+// every retired object must be destroyed once `Synchronize` returns.
+
+#include "epoch.h"
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what, const char* test) {
+    if (!condition) {
+        std::fprintf(stderr, "%s: %s\n", test, what);
+        ++failures;
+    }
+}
+
+std::atomic<int64_t> live = 0;
+
+// `check` always derives from `value`, so reading a destroyed node is likely to break it.
+struct Node : ThreadSafeRefCounted<Node, EpochRetire<>> {
+    explicit Node(int64_t value, std::atomic<bool>* destroyed = nullptr)
+        : value(value), check(~value), destroyed(destroyed) {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Node() {
+        check = value;
+        if (destroyed != nullptr) {
+            destroyed->store(true, std::memory_order_relaxed);
+        }
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool Whole() const {
+        return check == ~value;
+    }
+
+    int64_t value;
+    int64_t check;
+    std::atomic<bool>* destroyed;
+};
+
+constexpr size_t kReaders = 3;
+constexpr size_t kIterations = 20000;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Readers racing retirement
+
+// The writer keeps replacing the published node and drops the old one, which retires it. Readers
+// dereference whatever is published, and now and then take a reference with `TryPromote`. The
+// writer and the readers exit with retired objects left, which `Synchronize` must still destroy.
+void ReadersRaceRetire() {
+    std::atomic<Node*> published = nullptr;
+    std::atomic<bool> done = false;
+    std::atomic<size_t> torn = 0;
+
+    std::thread writer([&] {
+        IntrusivePtr<Node> owner;
+        for (size_t i = 0; i < kIterations; ++i) {
+            IntrusivePtr<Node> next = MakeIntrusive<Node>(static_cast<int64_t>(i));
+            published.store(next.Get(), std::memory_order_release);
+            owner = std::move(next);
+        }
+        // Unlinked before the last node is retired, like every node before it.
+        published.store(nullptr, std::memory_order_release);
+        done.store(true, std::memory_order_release);
+    });
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&] {
+            std::vector<IntrusivePtr<Node>> kept(8);
+            for (size_t round = 0; !done.load(std::memory_order_acquire); ++round) {
+                EpochGuard guard;
+                Node* node = published.load(std::memory_order_acquire);
+                if (node == nullptr) {
+                    continue;
+                }
+                if (!node->Whole()) {
+                    torn.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (round % 16 == 0) {
+                    kept[round / 16 % kept.size()] = TryPromote(node);
+                }
+            }
+        });
+    }
+
+    writer.join();
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    Check(torn.load() == 0, "a reader saw a destroyed node", __func__);
+    EpochDomain::Synchronize();
+    Check(live.load() == 0, "retired nodes were not destroyed", __func__);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Grace period
+
+// A node retired while a reader is pinned survives any number of collections, and is destroyed
+// once the reader has left.
+void PinnedReaderDelaysReclaim() {
+    std::atomic<bool> destroyed = false;
+    std::atomic<bool> pinned = false;
+    std::atomic<bool> leave = false;
+    bool whole = false;
+
+    IntrusivePtr<Node> owner = MakeIntrusive<Node>(1, &destroyed);
+    Node* node = owner.Get();
+    std::thread reader([&] {
+        EpochGuard guard;
+        Node* seen = node;
+        pinned.store(true, std::memory_order_release);
+        while (!leave.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        whole = seen->Whole();
+    });
+    while (!pinned.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    owner.Reset();
+    // Retiring enough nodes makes the domain try to advance and collect on its own.
+    for (size_t i = 0; i < 8 * EpochDomain::kCollectThreshold; ++i) {
+        MakeIntrusive<Node>(static_cast<int64_t>(i));
+    }
+    EpochDomain::Collect();
+    Check(!destroyed.load(), "a node was destroyed while a reader was pinned", __func__);
+
+    leave.store(true, std::memory_order_release);
+    reader.join();
+    Check(whole, "the reader saw a destroyed node", __func__);
+    EpochDomain::Synchronize();
+    Check(destroyed.load(), "the node was not destroyed after the grace period", __func__);
+    Check(live.load() == 0, "retired nodes were not destroyed", __func__);
+}
+
+}  // namespace
+
+int main() {
+    ReadersRaceRetire();
+    PinnedReaderDelaysReclaim();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
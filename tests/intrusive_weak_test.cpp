@@ -0,0 +1,118 @@
+// `IntrusiveWeakPtr::Lock` (intrusive_weak.h) racing the last `DecRef` of the object: a lock either
+// gets a live object or null, never a destroyed one, and the storage in front of over-aligned
+// objects is freed exactly once, by whichever reference goes last.
+
+#include "intrusive.h"
+#include "intrusive_weak.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what, const char* type, const char* test) {
+    if (!condition) {
+        std::fprintf(stderr, "%s<%s>: %s\n", test, type, what);
+        ++failures;
+    }
+}
+
+std::atomic<int64_t> live = 0;
+
+// `check` always derives from `value`, so a destroyed object is likely to break it.
+template <typename Derived>
+struct Tracked : ThreadSafeWeakRefCounted<Derived> {
+    Tracked() : value(live.fetch_add(1, std::memory_order_relaxed)), check(~value) {
+    }
+
+    ~Tracked() {
+        check = value;
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool Whole() const {
+        return check == ~value && reinterpret_cast<uintptr_t>(this) % alignof(Derived) == 0;
+    }
+
+    int64_t value;
+    int64_t check;
+};
+
+struct Plain : Tracked<Plain> {};
+
+// The counts are placed in front of the object with padding up to its alignment.
+struct alignas(64) Aligned : Tracked<Aligned> {};
+
+constexpr size_t kObjects = 20000;
+constexpr size_t kLockers = 3;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lock racing the last DecRef
+
+// One thread drops the only strong reference of each object while the others lock their weak
+// references to it, in the same order, so most drops meet a concurrent lock.
+template <typename T>
+void LockRacesLastDecRef(const char* type) {
+    std::vector<IntrusivePtr<T>> strong;
+    std::vector<IntrusiveWeakPtr<T>> weak;
+    for (size_t i = 0; i < kObjects; ++i) {
+        strong.push_back(MakeIntrusive<T>());
+        weak.emplace_back(strong.back());
+    }
+
+    std::atomic<bool> start = false;
+    std::atomic<size_t> torn = 0;
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        while (!start.load(std::memory_order_acquire)) {
+        }
+        for (IntrusivePtr<T>& ptr : strong) {
+            ptr.Reset();
+        }
+    });
+    for (size_t i = 0; i < kLockers; ++i) {
+        threads.emplace_back([&] {
+            // Copies, so the lockers also race each other on the weak count.
+            std::vector<IntrusiveWeakPtr<T>> mine = weak;
+            while (!start.load(std::memory_order_acquire)) {
+            }
+            for (IntrusiveWeakPtr<T>& ptr : mine) {
+                if (IntrusivePtr<T> locked = ptr.Lock()) {
+                    if (!locked->Whole()) {
+                        torn.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                ptr.Reset();
+            }
+        });
+    }
+    start.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    Check(torn.load() == 0, "a lock returned a destroyed object", type, __func__);
+    Check(live.load() == 0, "objects leaked or destroyed twice", type, __func__);
+    bool expired = true;
+    for (IntrusiveWeakPtr<T>& ptr : weak) {
+        expired = expired && ptr.Expired() && !ptr.Lock();
+    }
+    Check(expired, "a weak reference outlived its object", type, __func__);
+}
+
+}  // namespace
+
+int main() {
+    LockRacesLastDecRef<Plain>("Plain");
+    LockRacesLastDecRef<Aligned>("Aligned");
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Deferred destruction (reclaim.h): dropping the last reference only queues the object, and a
+// drain destroys it later, along with whatever its destructor queued in turn.
+
+#include "intrusive.h"
+#include "reclaim.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char* what, const char* test) {
+    if (!condition) {
+        std::fprintf(stderr, "%s: %s\n", test, what);
+        ++failures;
+    }
+}
+
+std::atomic<int64_t> live = 0;
+
+struct Tracked {
+    Tracked() {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Tracked() {
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Link of a chain: destroying one only queues the next.
+struct Link : ThreadSafeRefCounted<Link, DeferredDelete<>>, Tracked {
+    IntrusivePtr<Link> next;
+};
+
+constexpr size_t kChain = 100000;
+constexpr size_t kThreads = 4;
+constexpr size_t kIterations = 20000;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Deferred pointers
+
+// Nothing is destroyed before the drain, and each flavour is destroyed exactly once by it.
+void DrainDestroysQueued() {
+    {
+        UniquePtr<Tracked, DeferredDeleter<Tracked>> unique(new Tracked);
+        SharedPtr<Tracked> shared(new Tracked, DeferredDeleter<Tracked>());
+        SharedPtr<Tracked> copy = shared;
+        IntrusivePtr<Link> link = MakeIntrusive<Link>();
+    }
+    Check(live.load() == 3, "objects were destroyed before the drain", __func__);
+    Check(DrainReclaimQueue() == 3, "the drain destroyed a wrong number of objects", __func__);
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+    Check(ReclaimQueue::Empty(), "the queue is not empty after a drain", __func__);
+}
+
+// A chain long enough to overflow the stack if torn down recursively.
+void DrainTearsDownChainsIteratively() {
+    {
+        IntrusivePtr<Link> head;
+        for (size_t i = 0; i < kChain; ++i) {
+            IntrusivePtr<Link> link = MakeIntrusive<Link>();
+            link->next = std::move(head);
+            head = std::move(link);
+        }
+    }
+    Check(DrainReclaimQueue() == kChain, "the drain destroyed a wrong number of links", __func__);
+    Check(live.load() == 0, "links leaked or were destroyed twice", __func__);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reclaim thread
+
+// Threads queue objects while a `ReclaimThread` drains them; its destructor drains the rest.
+void ReclaimThreadRacesPushes() {
+    {
+        ReclaimThread reclaimer(std::chrono::milliseconds(1));
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < kThreads; ++i) {
+            threads.emplace_back([] {
+                for (size_t j = 0; j < kIterations; ++j) {
+                    IntrusivePtr<Link> link = MakeIntrusive<Link>();
+                    link->next = MakeIntrusive<Link>();
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    Check(live.load() == 0, "objects leaked or destroyed twice", __func__);
+    Check(ReclaimQueue::Empty(), "the queue is not empty after the reclaim thread", __func__);
+}
+
+}  // namespace
+
+int main() {
+    DrainDestroysQueued();
+    DrainTearsDownChainsIteratively();
+    ReclaimThreadRacesPushes();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+// Exact counter traffic of common patterns, checked through `RefTrace` (trace.h). Built with
+// SMART_POINTERS_TRACE by tests/CMakeLists.txt.
+
+#include "bulk.h"
+#include "intrusive.h"
+#include "relocating_vector.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+static_assert(kTraceRefs, "Build with -DSMART_POINTERS_TRACE");
+
+namespace {
+
+int failures = 0;
+
+void ExpectCount(size_t actual, size_t expected, const char* what, const char* type,
+                 const char* test) {
+    if (actual != expected) {
+        std::fprintf(stderr, "%s: %s of %s is %zu, expected %zu\n", test, what, type, actual,
+                     expected);
+        ++failures;
+    }
+}
+
+// Compare every operation `RefTrace<T>` recorded since its last `Reset` with `expected`.
+template <typename T>
+void ExpectTrace(const RefTraceCounts& expected, const char* type, const char* test) {
+    RefTraceCounts actual = RefTrace<T>::Counts();
+    ExpectCount(actual.inc, expected.inc, "inc", type, test);
+    ExpectCount(actual.dec, expected.dec, "dec", type, test);
+    ExpectCount(actual.weak_inc, expected.weak_inc, "weak_inc", type, test);
+    ExpectCount(actual.weak_dec, expected.weak_dec, "weak_dec", type, test);
+    ExpectCount(actual.allocs, expected.allocs, "allocs", type, test);
+    ExpectCount(actual.frees, expected.frees, "frees", type, test);
+}
+
+#define EXPECT_TRACE(T, ...) ExpectTrace<T>(RefTraceCounts{__VA_ARGS__}, #T, __func__)
+
+struct Node {
+    int value = 0;
+};
+
+struct Base {
+    virtual ~Base() = default;
+};
+
+struct Derived : Base {};
+
+struct Counted : SimpleRefCounted<Counted> {
+    int value = 0;
+};
+
+constexpr size_t kElements = 100;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Return by value
+
+SharedPtr<Node> MakeNode() {
+    SharedPtr<Node> node = MakeShared<Node>();
+    node->value = 1;
+    return node;
+}
+
+SharedPtr<Base> MakeBase() {
+    SharedPtr<Derived> derived = MakeShared<Derived>();
+    return derived;
+}
+
+IntrusivePtr<Counted> MakeCounted() {
+    IntrusivePtr<Counted> counted = MakeIntrusive<Counted>();
+    counted->value = 1;
+    return counted;
+}
+
+WeakPtr<Node> Observe(const SharedPtr<Node>& node) {
+    WeakPtr<Node> weak(node);
+    return weak;
+}
+
+class Holder {
+public:
+    SharedPtr<Node> Get() const {
+        return node_;
+    }
+
+private:
+    SharedPtr<Node> node_ = MakeShared<Node>();
+};
+
+void ReturnByValue() {
+    RefTrace<Node>::Reset();
+    {
+        SharedPtr<Node> node = MakeNode();
+    }
+    EXPECT_TRACE(Node, 0, 1, 0, 0, 1, 1);
+
+    // The converting move hands the reference over, too.
+    RefTrace<Base>::Reset();
+    RefTrace<Derived>::Reset();
+    {
+        SharedPtr<Base> base = MakeBase();
+    }
+    EXPECT_TRACE(Base, 0, 1, 0, 0, 0, 0);
+    EXPECT_TRACE(Derived, 0, 0, 0, 0, 1, 1);
+
+    RefTrace<Counted>::Reset();
+    {
+        IntrusivePtr<Counted> counted = MakeCounted();
+    }
+    EXPECT_TRACE(Counted, 1, 1, 0, 0, 1, 1);
+
+    SharedPtr<Node> node = MakeShared<Node>();
+    RefTrace<Node>::Reset();
+    {
+        WeakPtr<Node> weak = Observe(node);
+    }
+    EXPECT_TRACE(Node, 0, 0, 1, 1, 0, 0);
+
+    // Returning a member is a copy.
+    Holder holder;
+    RefTrace<Node>::Reset();
+    {
+        SharedPtr<Node> copy = holder.Get();
+    }
+    EXPECT_TRACE(Node, 1, 1, 0, 0, 0, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Vector growth
+
+void VectorGrowth() {
+    SharedPtr<Node> node = MakeShared<Node>();
+    RefTrace<Node>::Reset();
+    {
+        // One increment per element, none for the elements moved by reallocations.
+        std::vector<SharedPtr<Node>> nodes;
+        for (size_t i = 0; i < kElements; ++i) {
+            nodes.push_back(node);
+        }
+        EXPECT_TRACE(Node, kElements, 0, 0, 0, 0, 0);
+    }
+    EXPECT_TRACE(Node, kElements, kElements, 0, 0, 0, 0);
+
+    RefTrace<Node>::Reset();
+    {
+        std::vector<SharedPtr<Node>> nodes;
+        for (size_t i = 0; i < kElements; ++i) {
+            nodes.push_back(MakeShared<Node>());
+        }
+        EXPECT_TRACE(Node, 0, 0, 0, 0, kElements, 0);
+    }
+    EXPECT_TRACE(Node, 0, kElements, 0, 0, kElements, kElements);
+
+    RefTrace<Node>::Reset();
+    {
+        std::vector<WeakPtr<Node>> weak;
+        for (size_t i = 0; i < kElements; ++i) {
+            weak.emplace_back(node);
+        }
+    }
+    EXPECT_TRACE(Node, 0, 0, kElements, kElements, 0, 0);
+
+    RefTrace<Node>::Reset();
+    {
+        RelocatingVector<SharedPtr<Node>> nodes;
+        for (size_t i = 0; i < kElements; ++i) {
+            nodes.PushBack(node);
+        }
+        nodes.Erase(nodes.begin(), nodes.begin() + kElements / 2);
+        EXPECT_TRACE(Node, kElements, kElements / 2, 0, 0, 0, 0);
+    }
+    EXPECT_TRACE(Node, kElements, kElements, 0, 0, 0, 0);
+
+    IntrusivePtr<Counted> counted = MakeIntrusive<Counted>();
+    RefTrace<Counted>::Reset();
+    {
+        std::vector<IntrusivePtr<Counted>> all;
+        for (size_t i = 0; i < kElements; ++i) {
+            all.push_back(counted);
+        }
+    }
+    EXPECT_TRACE(Counted, kElements, kElements, 0, 0, 0, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Swap and move assignment
+
+void Swap() {
+    SharedPtr<Node> first = MakeShared<Node>();
+    SharedPtr<Node> second = MakeShared<Node>();
+    WeakPtr<Node> first_weak(first);
+    WeakPtr<Node> second_weak(second);
+    IntrusivePtr<Counted> first_counted = MakeIntrusive<Counted>();
+    IntrusivePtr<Counted> second_counted = MakeIntrusive<Counted>();
+    RefTrace<Node>::Reset();
+    RefTrace<Counted>::Reset();
+
+    first.Swap(second);
+    std::swap(first, second);
+    first_weak.Swap(second_weak);
+    std::swap(first_weak, second_weak);
+    first_counted.Swap(second_counted);
+    std::swap(first_counted, second_counted);
+
+    EXPECT_TRACE(Node, 0, 0, 0, 0, 0, 0);
+    EXPECT_TRACE(Counted, 0, 0, 0, 0, 0, 0);
+}
+
+void MoveAssignment() {
+    SharedPtr<Node> target = MakeShared<Node>();
+    SharedPtr<Node> source = MakeShared<Node>();
+    WeakPtr<Node> weak_target(target);
+    WeakPtr<Node> weak_source(source);
+    RefTrace<Node>::Reset();
+
+    // Only what the targets held before is released.
+    weak_target = std::move(weak_source);
+    target = std::move(source);
+    EXPECT_TRACE(Node, 0, 1, 0, 1, 0, 1);
+
+    IntrusivePtr<Counted> counted_target = MakeIntrusive<Counted>();
+    IntrusivePtr<Counted> counted_source = MakeIntrusive<Counted>();
+    RefTrace<Counted>::Reset();
+    counted_target = std::move(counted_source);
+    EXPECT_TRACE(Counted, 0, 1, 0, 0, 0, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bulk operations
+
+void Bulk() {
+    SharedPtr<Node> node = MakeShared<Node>();
+    std::vector<SharedPtr<Node>> sources(kElements, node);
+    std::vector<SharedPtr<Node>> copies(kElements);
+    RefTrace<Node>::Reset();
+
+    // One counter update for all the references to the same block, recorded once.
+    BulkCopy(sources.begin(), sources.end(), copies.begin());
+    EXPECT_TRACE(Node, 1, 0, 0, 0, 0, 0);
+    BulkReset(copies.begin(), copies.end());
+    EXPECT_TRACE(Node, 1, 1, 0, 0, 0, 0);
+}
+
+}  // namespace
+
+int main() {
+    ReturnByValue();
+    VectorGrowth();
+    Swap();
+    MoveAssignment();
+    Bulk();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
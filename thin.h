@@ -0,0 +1,271 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <type_traits>
+#include <utility>
+
+template <typename T, typename Counter = SimpleCounter>
+class ThinWeakPtr;
+
+template <typename T, typename Counter = SimpleCounter, typename... Args>
+ThinSharedPtr<T, Counter> MakeThinShared(Args&&... args);
+
+// `SharedPtr` to an object made by `MakeShared`, one pointer wide.
+//
+// Such an object is found through its control block alone: it lives inside the block at a fixed
+// offset, or behind the block's single pointer for `SplitPayload` types. The block is the one
+// `MakeShared<T, Counter>` picks (`MakeSharedBlock`), so its type is known statically, which also
+// makes the last release free of indirect calls. Converting from a `SharedPtr` checks that it owns
+// a `MakeShared<T, Counter>` object (no aliasing, no custom allocator) and throws `BadThinPtr`
+// otherwise; converting back never fails.
+template <typename T, typename Counter>
+class ThinSharedPtr {
+public:
+    using Block = MakeSharedBlock<T, Counter>;
+
+    static_assert(!std::is_array_v<T>, "Arrays are not allocated in place");
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ThinSharedPtr() : block_(nullptr) {
+    }
+
+    ThinSharedPtr(std::nullptr_t) : ThinSharedPtr() {
+    }
+
+    ThinSharedPtr(const ThinSharedPtr& other) : block_(other.block_) {
+        IncrementSharedCount();
+    }
+
+    ThinSharedPtr(ThinSharedPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    explicit ThinSharedPtr(const SharedPtr<T, Counter>& shared) : block_(BlockOf(shared)) {
+        IncrementSharedCount();
+    }
+
+    explicit ThinSharedPtr(SharedPtr<T, Counter>&& shared) : block_(BlockOf(shared)) {
+        shared.ptr_ = nullptr;
+        shared.control_block_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    ThinSharedPtr& operator=(const ThinSharedPtr& other) {
+        ThinSharedPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ThinSharedPtr& operator=(ThinSharedPtr&& other) noexcept {
+        ThinSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ThinSharedPtr() {
+        DecrementSharedCount();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Conversions
+
+    operator SharedPtr<T, Counter>() const& {
+        IncrementSharedCount();
+        return Wrap(block_);
+    }
+
+    operator SharedPtr<T, Counter>() && {
+        return Wrap(std::exchange(block_, nullptr));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        DecrementSharedCount();
+        block_ = nullptr;
+    }
+
+    void Swap(ThinSharedPtr& other) {
+        std::swap(block_, other.block_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return (block_ != nullptr ? block_->GetPtr() : nullptr);
+    }
+
+    T& operator*() const {
+        return *block_->GetPtr();
+    }
+
+    T* operator->() const {
+        return block_->GetPtr();
+    }
+
+    size_t UseCount() const {
+        return (block_ != nullptr ? block_->SharedCount() : 0);
+    }
+
+    explicit operator bool() const {
+        return (block_ != nullptr);
+    }
+
+private:
+    static Block* BlockOf(const SharedPtr<T, Counter>& shared) {
+        ControlBlockBase<Counter>* block = shared.control_block_;
+        if (block == nullptr) {
+            return nullptr;
+        }
+        if (!block->template Is<Block>() || static_cast<Block*>(block)->GetPtr() != shared.ptr_) {
+            throw BadThinPtr();
+        }
+        return static_cast<Block*>(block);
+    }
+
+    // Hands the reference held on `block` over to a `SharedPtr`.
+    static SharedPtr<T, Counter> Wrap(Block* block) {
+        SharedPtr<T, Counter> shared;
+        if (block != nullptr) {
+            shared.ptr_ = block->GetPtr();
+            shared.control_block_ = block;
+        }
+        return shared;
+    }
+
+    void IncrementSharedCount() const {
+        if (block_) {
+            TraceRef<T>(RefOp::kInc);
+            block_->IncSharedRef();
+        }
+    }
+
+    void DecrementSharedCount() {
+        if (block_) {
+            TraceRef<T>(RefOp::kDec);
+            block_->template DecSharedRefAs<Block>();
+        }
+    }
+
+    template <typename Tp, typename C>
+    friend class ThinWeakPtr;
+
+    template <typename Tp, typename C, typename... Args>
+    friend ThinSharedPtr<Tp, C> MakeThinShared(Args&&... args);
+
+    Block* block_;
+};
+
+// `WeakPtr` counterpart of `ThinSharedPtr`.
+template <typename T, typename Counter>
+class ThinWeakPtr {
+public:
+    using Block = typename ThinSharedPtr<T, Counter>::Block;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ThinWeakPtr() : block_(nullptr) {
+    }
+
+    ThinWeakPtr(const ThinWeakPtr& other) : block_(other.block_) {
+        IncrementWeakCount();
+    }
+
+    ThinWeakPtr(ThinWeakPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    ThinWeakPtr(const ThinSharedPtr<T, Counter>& shared) : block_(shared.block_) {
+        IncrementWeakCount();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    ThinWeakPtr& operator=(const ThinWeakPtr& other) {
+        ThinWeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ThinWeakPtr& operator=(ThinWeakPtr&& other) noexcept {
+        ThinWeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ThinWeakPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (block_) {
+            TraceRef<T>(RefOp::kWeakDec);
+            block_->DecWeakRef();
+        }
+        block_ = nullptr;
+    }
+
+    void Swap(ThinWeakPtr& other) {
+        std::swap(block_, other.block_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        return (block_ != nullptr ? block_->SharedCount() : 0);
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    ThinSharedPtr<T, Counter> Lock() const {
+        ThinSharedPtr<T, Counter> shared;
+        if (block_ && block_->TryIncSharedRef()) {
+            TraceRef<T>(RefOp::kInc);
+            shared.block_ = block_;
+        }
+        return shared;
+    }
+
+private:
+    void IncrementWeakCount() {
+        if (block_) {
+            TraceRef<T>(RefOp::kWeakInc);
+            block_->IncWeakRef();
+        }
+    }
+
+    Block* block_;
+};
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<ThinSharedPtr<T, Counter>> : std::true_type {};
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<ThinWeakPtr<T, Counter>> : std::true_type {};
+
+// Same as `ThinSharedPtr(MakeShared<T, Counter>(args...))`, without the check
+template <typename T, typename Counter, typename... Args>
+ThinSharedPtr<T, Counter> MakeThinShared(Args&&... args) {
+    using Block = typename ThinSharedPtr<T, Counter>::Block;
+    ThinSharedPtr<T, Counter> shared;
+    shared.block_ = NewControlBlock<Block>(ControlBlockAlloc<T>(), ControlBlockAlloc<T>(),
+                                           std::forward<Args>(args)...);
+    AssignWeakThis(shared.block_->GetPtr(), shared.block_->GetPtr(), shared.block_);
+    return shared;
+}
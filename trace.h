@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// Build with -DSMART_POINTERS_TRACE to count reference count operations and allocations per
+// pointee type, e.g. to check that a code path makes no counter traffic:
+//
+//     RefTrace<Node>::Reset();
+//     std::vector<SharedPtr<Node>> grown = Grow(nodes);
+//     assert(RefTrace<Node>::Counts().inc == 0);
+//
+// Operations are attributed to the type the pointer or block sees at that point: a block made by
+// `SharedPtr<Base>(new Derived)` is counted under `Derived`, the references to it under `Base`.
+// A bulk change of `n` references (bulk.h, `RefCounted::IncRef(n)`) is one update of the counter
+// and is recorded as a single `kInc` or `kDec`, whatever `n` is.
+// Without the macro the hooks are empty and nothing is stored.
+#ifdef SMART_POINTERS_TRACE
+inline constexpr bool kTraceRefs = true;
+#else
+inline constexpr bool kTraceRefs = false;
+#endif
+
+enum class RefOp { kInc, kDec, kWeakInc, kWeakDec, kAlloc, kFree, kCount };
+
+struct RefTraceCounts {
+    size_t inc;
+    size_t dec;
+    size_t weak_inc;
+    size_t weak_dec;
+    size_t allocs;
+    size_t frees;
+};
+
+template <typename T>
+class RefTrace {
+public:
+    static void Record(RefOp op) {
+        if constexpr (kTraceRefs) {
+            counts_[static_cast<size_t>(op)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static RefTraceCounts Counts() {
+        return {Get(RefOp::kInc),     Get(RefOp::kDec),   Get(RefOp::kWeakInc),
+                Get(RefOp::kWeakDec), Get(RefOp::kAlloc), Get(RefOp::kFree)};
+    }
+
+    static void Reset() {
+        for (std::atomic<size_t>& count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static size_t Get(RefOp op) {
+        return counts_[static_cast<size_t>(op)].load(std::memory_order_relaxed);
+    }
+
+    static inline std::atomic<size_t> counts_[static_cast<size_t>(RefOp::kCount)] = {};
+};
+
+template <typename T>
+void TraceRef(RefOp op) {
+    RefTrace<std::remove_cv_t<T>>::Record(op);
+}
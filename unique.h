@@ -1,9 +1,12 @@
 #pragma once
 
+#include "borrow_check.h"
 #include "compressed_pair.h"
+#include "relocatable.h"
 
 #include <cstddef>  // std::nullptr_t
 #include <type_traits>
+#include <utility>
 
 template <typename T>
 struct DefaultDeleter {
@@ -108,6 +111,7 @@ public:
         T* tmp = Get();
         Compressed::GetFirst() = ptr;
         if (tmp != ptr && tmp != nullptr) {
+            BorrowCheck::Released(tmp);
             GetDeleter()(tmp);
         }
     }
@@ -301,3 +305,33 @@ public:
         return *(Compressed::GetFirst() + i);
     }
 };
+
+// Only the deleter can tie a `UniquePtr` to its address.
+template <typename T, typename Deleter>
+struct IsTriviallyRelocatable<UniquePtr<T, Deleter>> : IsTriviallyRelocatable<Deleter> {};
+
+// https://en.cppreference.com/w/cpp/memory/unique_ptr/make_unique
+template <typename T, typename... Args>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUnique(Args&&... args) {
+    return UniquePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+// `size` value-initialized elements
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0, UniquePtr<T>> MakeUnique(
+    size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]());
+}
+
+// Same as `MakeUnique`, but default-initialized: trivial objects and elements are left as they
+// are instead of being zeroed. For buffers that are about to be overwritten anyway.
+template <typename T>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0, UniquePtr<T>> MakeUniqueForOverwrite(
+    size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]);
+}
@@ -3,11 +3,8 @@
 #include "sw_fwd.h"  // Forward declaration
 #include "shared.h"
 
-template <typename T>
-class SharedPtr;
-
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Counter>
 class WeakPtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -24,16 +21,16 @@ public:
         IncrementWeakCount();
     }
 
-    WeakPtr(WeakPtr&& other) {
+    WeakPtr(WeakPtr&& other) noexcept {
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
-        IncrementWeakCount();
-        other.Reset();
+        other.ptr_ = nullptr;
+        other.control_block_ = nullptr;
     }
 
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) {
+    WeakPtr(const SharedPtr<T, Counter>& other) {
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
         IncrementWeakCount();
@@ -50,12 +47,16 @@ public:
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) {
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
         Reset();
         ptr_ = other.ptr_;
         control_block_ = other.control_block_;
-        IncrementWeakCount();
-        other.Reset();
+        other.ptr_ = nullptr;
+        other.control_block_ = nullptr;
         return *this;
     }
 
@@ -63,21 +64,14 @@ public:
     // Destructor
 
     ~WeakPtr() {
-        if (control_block_) {
-            control_block_->weak_count_--;
-            DeleteFromBlock();
-        }
+        DecrementWeakCount();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
     void Reset() {
-        if (control_block_) {
-            control_block_->weak_count_--;
-            DeleteFromBlock();
-        }
-
+        DecrementWeakCount();
         ptr_ = nullptr;
         control_block_ = nullptr;
     }
@@ -91,25 +85,29 @@ public:
     // Observers
 
     size_t UseCount() const {
-        return (control_block_ != nullptr ? control_block_->shared_count_ : 0);
+        return (control_block_ != nullptr ? control_block_->SharedCount() : 0);
     }
 
     bool Expired() const {
         if (control_block_ == nullptr) {
             return true;
         }
-        return (control_block_->shared_count_ == 0);
+        return (control_block_->SharedCount() == 0);
     }
 
-    SharedPtr<T> Lock() const {
-        if (Expired()) {
-            return SharedPtr<T>();
+    // Never revives an object whose last strong reference is already gone: the shared count is
+    // only bumped if it is still non-zero.
+    SharedPtr<T, Counter> Lock() const {
+        SharedPtr<T, Counter> shared;
+        if (control_block_ && control_block_->TryIncSharedRef()) {
+            TraceRef<std::remove_extent_t<T>>(RefOp::kInc);
+            shared.ptr_ = ptr_;
+            shared.control_block_ = control_block_;
         }
-        SharedPtr<T> shared(*this);
         return shared;
     }
 
-    T* Get() const {
+    std::remove_extent_t<T>* Get() const {
         if (Expired()) {
             return nullptr;
         }
@@ -119,25 +117,116 @@ public:
 private:
     inline void IncrementWeakCount() {
         if (control_block_) {
-            ++control_block_->weak_count_;
+            TraceRef<std::remove_extent_t<T>>(RefOp::kWeakInc);
+            control_block_->IncWeakRef();
         }
     }
 
-    inline void DeleteFromBlock() {
-        if (control_block_->shared_count_ == 0 && control_block_->weak_count_ == 0) {
-            delete control_block_;
-            control_block_ = nullptr;
-        } else if (control_block_->shared_count_ == 0) {
-            control_block_->DeleteData();
+    void DecrementWeakCount() {
+        if (control_block_) {
+            TraceRef<std::remove_extent_t<T>>(RefOp::kWeakDec);
+            control_block_->DecWeakRef();
         }
     }
 
-    T* ptr_;
-    ControlBlockBase* control_block_;
+    std::remove_extent_t<T>* ptr_;
+    ControlBlockBase<Counter>* control_block_;
 
-    template <typename Tp>
+    template <typename Tp, typename C>
     friend class SharedPtr;
 
-    template <typename Tp>
+    template <typename Tp, typename C>
     friend class EnableSharedFromThis;
 };
+
+template <typename T, typename Counter>
+SharedPtr<T, Counter>::SharedPtr(const WeakPtr<T, Counter>& other) {
+    if (other.control_block_ == nullptr || !other.control_block_->TryIncSharedRef()) {
+        throw BadWeakPtr();
+    }
+    TraceRef<std::remove_extent_t<T>>(RefOp::kInc);
+    ptr_ = other.ptr_;
+    control_block_ = other.control_block_;
+}
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<WeakPtr<T, Counter>> : std::true_type {};
+
+// Base of objects that need a `SharedPtr` to themselves, e.g. to keep themselves alive in a
+// callback:
+//
+//     class Session : public EnableSharedFromThis<Session> {
+//         void Start() {
+//             socket_.AsyncRead([self = SharedFromThis()] { self->OnRead(); });
+//         }
+//     };
+//
+// The base holds a `WeakPtr` to the object's own control block, set by whichever `MakeShared`,
+// `AllocateShared`, `SharedPtr(Y*)` or `Reset(Y*)` first takes ownership of the object. Nothing
+// extra is allocated: the weak reference lives in the object and counts on the existing block.
+// `SharedFromThis` throws `BadWeakPtr` if no `SharedPtr<T, Counter>` owns the object (yet), e.g.
+// in its constructor or for an object on the stack.
+template <typename T, typename Counter>
+class EnableSharedFromThis {
+public:
+    SharedPtr<T, Counter> SharedFromThis() {
+        return SharedPtr<T, Counter>(weak_this_);
+    }
+
+    SharedPtr<const T, Counter> SharedFromThis() const {
+        return SharedPtr<T, Counter>(weak_this_);
+    }
+
+    WeakPtr<T, Counter> WeakFromThis() noexcept {
+        return weak_this_;
+    }
+
+    WeakPtr<const T, Counter> WeakFromThis() const noexcept {
+        WeakPtr<const T, Counter> weak;
+        weak.ptr_ = weak_this_.ptr_;
+        weak.control_block_ = weak_this_.control_block_;
+        weak.IncrementWeakCount();
+        return weak;
+    }
+
+protected:
+    EnableSharedFromThis() = default;
+
+    // A copy is a different object, owned by nobody yet.
+    EnableSharedFromThis(const EnableSharedFromThis&) {
+    }
+
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) {
+        return *this;
+    }
+
+    ~EnableSharedFromThis() = default;
+
+private:
+    void SetWeakThis(T* ptr, ControlBlockBase<Counter>* block) const {
+        if (!weak_this_.Expired()) {
+            return;
+        }
+        weak_this_.Reset();
+        weak_this_.ptr_ = ptr;
+        weak_this_.control_block_ = block;
+        weak_this_.IncrementWeakCount();
+    }
+
+    template <typename U, typename C, typename Y>
+    friend void AssignWeakThis(const EnableSharedFromThis<U, C>* base, Y* ptr,
+                               ControlBlockBase<C>* block);
+
+    template <typename U>
+    friend class Borrowed;
+
+    mutable WeakPtr<T, Counter> weak_this_;
+};
+
+template <typename U, typename Counter, typename Y>
+void AssignWeakThis(const EnableSharedFromThis<U, Counter>* base, Y* ptr,
+                    ControlBlockBase<Counter>* block) {
+    if (base != nullptr) {
+        base->SetWeakThis(static_cast<U*>(const_cast<std::remove_cv_t<Y>*>(ptr)), block);
+    }
+}
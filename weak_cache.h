@@ -0,0 +1,164 @@
+#pragma once
+
+#include "weak.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+// Interning map that does not keep its values alive: entries are `WeakPtr`s, so a value is
+// destroyed as soon as its last user drops it, and the entry goes away lazily afterwards.
+//
+//     WeakValueCache<std::string, Schema> schemas;
+//     SharedPtr<Schema, AtomicCounter> schema = schemas.GetOrCreate(name, text);
+//
+// Keys are spread over independently locked shards. Lookups take their shard's lock shared and
+// promote the entry with `WeakPtr::Lock`. `GetOrCreate` constructs the value outside of the lock,
+// and at most once per key: threads that race for a missing key wait for the one constructing it.
+// Expired entries are dropped when a lookup runs into them and by a sweep of the shard once it
+// has grown by as many insertions as it had entries at the last sweep.
+template <typename K, typename V, typename Counter = AtomicCounter,
+          typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class WeakValueCache {
+public:
+    using Shared = SharedPtr<V, Counter>;
+    using Weak = WeakPtr<V, Counter>;
+
+    static constexpr size_t kDefaultShards = 16;
+
+    explicit WeakValueCache(size_t shards = kDefaultShards)
+        : shard_count_(shards != 0 ? shards : 1), shards_(new Shard[shard_count_]) {
+    }
+
+    WeakValueCache(const WeakValueCache&) = delete;
+    WeakValueCache& operator=(const WeakValueCache&) = delete;
+
+    // The live value stored under `key`, or an empty pointer.
+    Shared Find(const K& key) {
+        Shard& shard = ShardOf(key);
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.entries.find(key);
+            if (it == shard.entries.end()) {
+                return Shared();
+            }
+            if (Shared value = it->second.Lock()) {
+                return value;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return LockOrErase(shard, key);
+    }
+
+    // The live value stored under `key`; if there is none, `MakeShared<V, Counter>(args...)`
+    // stored under `key`. If the construction throws, nothing is stored and a waiting thread
+    // tries again.
+    template <typename... Args>
+    Shared GetOrCreate(const K& key, Args&&... args) {
+        if (Shared value = Find(key)) {
+            return value;
+        }
+
+        Shard& shard = ShardOf(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        while (true) {
+            if (Shared value = LockOrErase(shard, key)) {
+                return value;
+            }
+            if (shard.pending.count(key) == 0) {
+                break;
+            }
+            shard.created.wait(lock);
+        }
+        shard.pending.insert(key);
+        lock.unlock();
+
+        Shared value;
+        try {
+            value = MakeShared<V, Counter>(std::forward<Args>(args)...);
+        } catch (...) {
+            lock.lock();
+            shard.pending.erase(key);
+            lock.unlock();
+            shard.created.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        shard.pending.erase(key);
+        shard.entries.insert_or_assign(key, Weak(value));
+        if (++shard.inserted_since_sweep > shard.swept_size) {
+            Sweep(shard);
+        }
+        lock.unlock();
+        shard.created.notify_all();
+        return value;
+    }
+
+    // Drop every expired entry now.
+    void Purge() {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::unique_lock<std::shared_mutex> lock(shards_[i].mutex);
+            Sweep(shards_[i]);
+        }
+    }
+
+    // Number of entries, including expired ones not purged yet.
+    size_t Size() const {
+        size_t size = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            size += shards_[i].entries.size();
+        }
+        return size;
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::condition_variable_any created;
+        std::unordered_map<K, Weak, Hash, KeyEqual> entries;
+        // Keys whose value is being constructed.
+        std::unordered_set<K, Hash, KeyEqual> pending;
+        size_t inserted_since_sweep = 0;
+        size_t swept_size = 0;
+    };
+
+    Shard& ShardOf(const K& key) {
+        return shards_[Hash()(key) % shard_count_];
+    }
+
+    // Called with the shard locked exclusively.
+    static Shared LockOrErase(Shard& shard, const K& key) {
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            return Shared();
+        }
+        Shared value = it->second.Lock();
+        if (!value) {
+            shard.entries.erase(it);
+        }
+        return value;
+    }
+
+    static void Sweep(Shard& shard) {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (it->second.Expired()) {
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        shard.inserted_since_sweep = 0;
+        shard.swept_size = shard.entries.size();
+    }
+
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+};